@@ -0,0 +1,488 @@
+// Microbenchmarks for the intersection, traversal and sample warping kernels
+//
+// Every kernel runs over fixed ray, primitive and sample sets from a seeded generator, so two builds see the same
+// work. Each one gets warmup passes and then timed repetitions, reported as nanoseconds per call to stdout,
+// benchmark.csv and benchmark.json. The 8 wide warps are checked against the scalar ones first, and the run fails
+// if they disagree.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vec3.h"
+#include "ray.h"
+#include "object.h"
+#include "sphere.h"
+#include "triangle.h"
+#include "material.h"
+#include "BVH.h"
+#include "Octree.h"
+#include "mesh.h"
+#include "Model.h"
+#include "ModelLoader.h"
+#include "Warp.h"
+#include "util.h"
+
+// Defaults, all can be changed on the command line
+int warmup_passes = 3;
+int repetitions = 15;
+int ray_count = 1024; // Rays per pass against the primitive sets
+int primitive_count = 256;
+int traversal_ray_count = 16384; // Rays per pass against each model
+int warp_sample_count = 65536; // Samples per pass through each warp, rounded up to whole batches
+std::string models_dir = "../bidirectional-path-tracing/Models/";
+std::string csv_path = "benchmark.csv";
+std::string json_path = "benchmark.json";
+
+char const* const kModels[] = { "Monkey.obj", "Handgun.obj", "Dog.obj", "Cube45.obj" };
+
+// Largest difference allowed between an 8 wide warp and its scalar version, the batched sin and cos are
+// polynomials and the angle is rounded differently
+float const kWarpTolerance = 1e-5f;
+
+// Small fixed generator so the sets don't depend on the standard library's distributions
+class BenchRandom {
+public:
+	explicit BenchRandom(uint64_t const seed) : mState(seed) {}
+
+	float Next() {
+		mState ^= mState << 13;
+		mState ^= mState >> 7;
+		mState ^= mState << 17;
+		return (float)(mState >> 40) * (1.f / 16777216.f);
+	}
+
+	float Range(float const lo, float const hi) {
+		return lo + (hi - lo) * Next();
+	}
+
+	Vec3 InBox(Vec3 const& lo, Vec3 const& hi) {
+		float const x = Range(lo.x(), hi.x());
+		float const y = Range(lo.y(), hi.y());
+		float const z = Range(lo.z(), hi.z());
+		return Vec3(x, y, z);
+	}
+
+	Vec3 OnSphere() {
+		Vec2 const u(Next(), Next());
+		return SquareToUniformSphere(u);
+	}
+
+private:
+	uint64_t mState;
+};
+
+// Timing of one kernel, per call
+struct BenchResult {
+	std::string mKernel;
+	std::string mScene;
+	int mPrimitives;
+	uint64_t mCalls; // Per repetition
+	uint64_t mHits; // Per repetition, also keeps the work from being optimized out
+	double mMin;
+	double mP10;
+	double mMedian;
+	double mP90;
+	double mMax;
+};
+
+// Nearest rank percentile of sorted samples
+double Percentile(std::vector<double> const& sorted, int const percent) {
+	size_t const rank = (sorted.size() - 1) * percent / 100;
+	return sorted[rank];
+}
+
+// Run pass warmup_passes times, then time it repetitions times. pass returns how many of its calls hit
+BenchResult RunKernel(char const* kernel, std::string const& scene, int const primitives, uint64_t const calls, std::function<uint64_t()> const& pass) {
+	uint64_t hits = 0;
+	for (int ii = 0; ii < warmup_passes; ++ii) {
+		hits = pass();
+	}
+
+	std::vector<double> nsPerCall;
+	for (int ii = 0; ii < repetitions; ++ii) {
+		auto const start = std::chrono::steady_clock::now();
+		uint64_t const repHits = pass();
+		auto const end = std::chrono::steady_clock::now();
+		double const ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		nsPerCall.push_back(ns / (double)calls);
+
+		// Every pass does the same work, a different answer means the kernel isn't deterministic
+		if (warmup_passes > 0 && repHits != hits) {
+			printf("Warning: %s on %s hit %llu then %llu\n", kernel, scene.c_str(), (unsigned long long)hits, (unsigned long long)repHits);
+		}
+		hits = repHits;
+	}
+	std::sort(nsPerCall.begin(), nsPerCall.end());
+
+	BenchResult result;
+	result.mKernel = kernel;
+	result.mScene = scene;
+	result.mPrimitives = primitives;
+	result.mCalls = calls;
+	result.mHits = hits;
+	result.mMin = nsPerCall.front();
+	result.mP10 = Percentile(nsPerCall, 10);
+	result.mMedian = Percentile(nsPerCall, 50);
+	result.mP90 = Percentile(nsPerCall, 90);
+	result.mMax = nsPerCall.back();
+
+	printf("%-16s %-12s %9llu calls %6.1f%% hit  median %9.2f ns  p10 %9.2f  p90 %9.2f\n",
+		kernel, scene.c_str(), (unsigned long long)calls, 100.0 * (double)hits / (double)calls, result.mMedian, result.mP10, result.mP90);
+	return result;
+}
+
+// Rays from all around the [-1, 1] cube aimed at points inside it, where the primitives are
+std::vector<Ray> RandomRays(BenchRandom& random, int const count) {
+	std::vector<Ray> rays;
+	rays.reserve(count);
+	for (int ii = 0; ii < count; ++ii) {
+		Vec3 const origin = 3.f * random.OnSphere();
+		Vec3 const target = random.InBox(Vec3(-1, -1, -1), Vec3(1, 1, 1));
+		rays.push_back(Ray(origin, normalize(target - origin)));
+	}
+	return rays;
+}
+
+// Primitive kernels, every ray against every primitive
+void BenchPrimitives(std::vector<BenchResult>& results) {
+	BenchRandom random(0x9E3779B97F4A7C15ull);
+	std::vector<Ray> const rays = RandomRays(random, ray_count);
+	uint64_t const calls = (uint64_t)ray_count * (uint64_t)primitive_count;
+
+	std::vector<Box> boxes;
+	std::vector<Triangle> triangles;
+	std::vector<Sphere> spheres;
+	for (int ii = 0; ii < primitive_count; ++ii) {
+		Vec3 const center = random.InBox(Vec3(-1, -1, -1), Vec3(1, 1, 1));
+		Vec3 const half(random.Range(0.05f, 0.5f), random.Range(0.05f, 0.5f), random.Range(0.05f, 0.5f));
+		boxes.push_back(Box(center - half, center + half));
+
+		Vec3 const a = center + 0.5f * random.OnSphere();
+		Vec3 const b = center + 0.5f * random.OnSphere();
+		Vec3 const c = center + 0.5f * random.OnSphere();
+		triangles.push_back(Triangle(a, b, c, nullptr));
+
+		spheres.push_back(Sphere(center, random.Range(0.05f, 0.5f), nullptr));
+	}
+
+	results.push_back(RunKernel("Box::Hit", "random", primitive_count, calls, [&]() {
+		uint64_t hits = 0;
+		for (Ray const& r : rays) {
+			for (Box const& box : boxes) {
+				float tmin;
+				float tmax;
+				hits += box.Hit(r, tmin, tmax) ? 1 : 0;
+			}
+		}
+		return hits;
+	}));
+
+	results.push_back(RunKernel("Triangle::Hit", "random", primitive_count, calls, [&]() {
+		uint64_t hits = 0;
+		HitRecord rec;
+		for (Ray const& r : rays) {
+			for (Triangle const& triangle : triangles) {
+				hits += triangle.Hit(r, r.tMin, r.tMax, rec) ? 1 : 0;
+			}
+		}
+		return hits;
+	}));
+
+	results.push_back(RunKernel("Sphere::Hit", "random", primitive_count, calls, [&]() {
+		uint64_t hits = 0;
+		HitRecord rec;
+		for (Ray const& r : rays) {
+			for (Sphere const& sphere : spheres) {
+				hits += sphere.Hit(r, r.tMin, r.tMax, rec) ? 1 : 0;
+			}
+		}
+		return hits;
+	}));
+}
+
+// Traversal kernels, one closest hit query per ray through a BVH and an Octree over every triangle of the model
+void BenchModel(char const* name, std::vector<BenchResult>& results) {
+	Arena arena;
+	ModelLoader loader(arena);
+	Model const* model = loader.LoadModel(models_dir + name);
+	if (!model) {
+		printf("Skipping %s\n", name);
+		return;
+	}
+
+	// Every mesh in one buffer, the Octree gets a Triangle object for each face
+	VertexBuffer vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Object*> objects;
+	for (uint32_t ii = 0; ii < model->mMeshCount; ++ii) {
+		Mesh const* mesh = model->mMeshes[ii];
+		uint32_t const base = (uint32_t)vertices.Size();
+		for (uint32_t jj = 0; jj < (uint32_t)mesh->mVertices.Size(); ++jj) {
+			vertices.Add(mesh->mVertices.Position(jj), mesh->mVertices.Normal(jj), mesh->mVertices.TexCoords(jj));
+		}
+		for (uint32_t jj = 0; jj < mesh->mIndexCount; ++jj) {
+			indices.push_back(base + mesh->mIndices[jj]);
+		}
+	}
+	for (size_t ii = 0; ii < indices.size(); ii += 3) {
+		objects.push_back(arena.New<Triangle>(vertices.Position(indices[ii]), vertices.Position(indices[ii + 1]), vertices.Position(indices[ii + 2]), nullptr));
+	}
+
+	auto const buildStart = std::chrono::steady_clock::now();
+	BVH const bvh(vertices, indices.data(), (uint32_t)indices.size(), arena);
+	auto const buildMid = std::chrono::steady_clock::now();
+	Octree const octree(objects, 0, arena);
+	auto const buildEnd = std::chrono::steady_clock::now();
+	printf("%s: %d triangles, BVH build %.2f ms, Octree build %.2f ms\n", name, (int)objects.size(),
+		std::chrono::duration<double, std::milli>(buildMid - buildStart).count(),
+		std::chrono::duration<double, std::milli>(buildEnd - buildMid).count());
+
+	// Rays from a sphere around the model aimed at points inside its bounds
+	Box const& bounds = bvh.mBoundingBox;
+	Vec3 const center = bounds.Center();
+	float const radius = bounds.GetSize().length();
+	BenchRandom random(0xD1B54A32D192ED03ull);
+	std::vector<Ray> rays;
+	rays.reserve(traversal_ray_count);
+	for (int ii = 0; ii < traversal_ray_count; ++ii) {
+		Vec3 const origin = center + radius * random.OnSphere();
+		Vec3 const target = random.InBox(bounds.mMin, bounds.mMax);
+		rays.push_back(Ray(origin, normalize(target - origin)));
+	}
+
+	std::string const scene(name, strchr(name, '.') - name);
+	int const primitives = (int)objects.size();
+
+	results.push_back(RunKernel("BVH::Hit", scene, primitives, (uint64_t)traversal_ray_count, [&]() {
+		uint64_t hits = 0;
+		HitRecord rec;
+		for (Ray const& r : rays) {
+			hits += bvh.Hit(r, r.tMin, r.tMax, rec) ? 1 : 0;
+		}
+		return hits;
+	}));
+
+	results.push_back(RunKernel("Octree::Hit", scene, primitives, (uint64_t)traversal_ray_count, [&]() {
+		uint64_t hits = 0;
+		HitRecord rec;
+		for (Ray const& r : rays) {
+			hits += octree.Hit(r, r.tMin, r.tMax, rec) ? 1 : 0;
+		}
+		return hits;
+	}));
+}
+
+// Time a warp one sample at a time and 8 at a time, after checking the two agree on every sample. scalar(ii, x, y, z)
+// maps sample ii, batch(ii, x, y, z) maps the 8 from ii on. Warps with two outputs leave z alone. False if they
+// disagree
+template <typename Scalar, typename Batch>
+bool BenchWarp(char const* scalarName, char const* batchName, Scalar const& scalar, Batch const& batch, std::vector<BenchResult>& results) {
+	size_t const count = (size_t)warp_sample_count;
+	std::vector<float> scalarOut[3];
+	std::vector<float> batchOut[3];
+	for (int output = 0; output < 3; ++output) {
+		scalarOut[output].assign(count, 0.f);
+		batchOut[output].assign(count, 0.f);
+	}
+	for (size_t ii = 0; ii < count; ++ii) {
+		scalar(ii, scalarOut[0][ii], scalarOut[1][ii], scalarOut[2][ii]);
+	}
+	for (size_t ii = 0; ii < count; ii += kWarpBatchSize) {
+		batch(ii, &batchOut[0][ii], &batchOut[1][ii], &batchOut[2][ii]);
+	}
+	float maxDifference = 0.f;
+	for (int output = 0; output < 3; ++output) {
+		for (size_t ii = 0; ii < count; ++ii) {
+			maxDifference = std::max(maxDifference, fabsf(scalarOut[output][ii] - batchOut[output][ii]));
+		}
+	}
+	bool const agree = maxDifference <= kWarpTolerance;
+	printf("%-16s %-12s max difference from %s %.2e%s\n", batchName, "warp", scalarName, maxDifference, agree ? "" : ", too large");
+
+	// Counting positive x keeps the outputs from being optimized out
+	results.push_back(RunKernel(scalarName, "warp", 0, count, [&]() {
+		uint64_t positive = 0;
+		for (size_t ii = 0; ii < count; ++ii) {
+			scalar(ii, scalarOut[0][ii], scalarOut[1][ii], scalarOut[2][ii]);
+			positive += scalarOut[0][ii] > 0.f ? 1 : 0;
+		}
+		return positive;
+	}));
+	results.push_back(RunKernel(batchName, "warp", 0, count, [&]() {
+		uint64_t positive = 0;
+		for (size_t ii = 0; ii < count; ii += kWarpBatchSize) {
+			batch(ii, &batchOut[0][ii], &batchOut[1][ii], &batchOut[2][ii]);
+			for (int lane = 0; lane < kWarpBatchSize; ++lane) {
+				positive += batchOut[0][ii + lane] > 0.f ? 1 : 0;
+			}
+		}
+		return positive;
+	}));
+	return agree;
+}
+
+// Every warp that has an 8 wide version, over uniform samples that start with the corners and edges of the
+// square. False if any batch disagrees with its scalar version
+bool BenchWarps(std::vector<BenchResult>& results) {
+	warp_sample_count = (warp_sample_count + kWarpBatchSize - 1) / kWarpBatchSize * kWarpBatchSize;
+	size_t const count = (size_t)warp_sample_count;
+	BenchRandom random(0x2545F4914F6CDD1Dull);
+	float const edges[] = { 0.f, 0.5f, 1.f };
+	std::vector<float> u0;
+	std::vector<float> u1;
+	std::vector<float> cosThetaMax;
+	for (size_t ii = 0; ii < count; ++ii) {
+		bool const edge = ii < 9;
+		u0.push_back(edge ? edges[ii / 3] : random.Next());
+		u1.push_back(edge ? edges[ii % 3] : random.Next());
+		cosThetaMax.push_back(random.Range(-1.f, 1.f));
+	}
+
+	bool agree = true;
+	agree &= BenchWarp("Warp::Disk", "Warp::Disk8", [&](size_t const ii, float& x, float& y, float&) {
+		Vec2 const d = SquareToConcentricDisk(Vec2(u0[ii], u1[ii]));
+		x = d.x();
+		y = d.y();
+	}, [&](size_t const ii, float* x, float* y, float*) {
+		SquareToConcentricDisk8(&u0[ii], &u1[ii], x, y);
+	}, results);
+	agree &= BenchWarp("Warp::Hemi", "Warp::Hemi8", [&](size_t const ii, float& x, float& y, float& z) {
+		Vec3 const d = SquareToUniformHemisphere(Vec2(u0[ii], u1[ii]));
+		x = d.x();
+		y = d.y();
+		z = d.z();
+	}, [&](size_t const ii, float* x, float* y, float* z) {
+		SquareToUniformHemisphere8(&u0[ii], &u1[ii], x, y, z);
+	}, results);
+	agree &= BenchWarp("Warp::CosHemi", "Warp::CosHemi8", [&](size_t const ii, float& x, float& y, float& z) {
+		Vec3 const d = SquareToCosineHemisphere(Vec2(u0[ii], u1[ii]));
+		x = d.x();
+		y = d.y();
+		z = d.z();
+	}, [&](size_t const ii, float* x, float* y, float* z) {
+		SquareToCosineHemisphere8(&u0[ii], &u1[ii], x, y, z);
+	}, results);
+	agree &= BenchWarp("Warp::Cap", "Warp::Cap8", [&](size_t const ii, float& x, float& y, float& z) {
+		Vec3 const d = SquareToSphericalCap(Vec2(u0[ii], u1[ii]), cosThetaMax[ii]);
+		x = d.x();
+		y = d.y();
+		z = d.z();
+	}, [&](size_t const ii, float* x, float* y, float* z) {
+		SquareToSphericalCap8(&u0[ii], &u1[ii], &cosThetaMax[ii], x, y, z);
+	}, results);
+	agree &= BenchWarp("Warp::Sphere", "Warp::Sphere8", [&](size_t const ii, float& x, float& y, float& z) {
+		Vec3 const d = SquareToUniformSphere(Vec2(u0[ii], u1[ii]));
+		x = d.x();
+		y = d.y();
+		z = d.z();
+	}, [&](size_t const ii, float* x, float* y, float* z) {
+		SquareToUniformSphere8(&u0[ii], &u1[ii], x, y, z);
+	}, results);
+	agree &= BenchWarp("Warp::Triangle", "Warp::Triangle8", [&](size_t const ii, float& x, float& y, float&) {
+		Vec2 const b = SquareToTriangle(Vec2(u0[ii], u1[ii]));
+		x = b.x();
+		y = b.y();
+	}, [&](size_t const ii, float* x, float* y, float*) {
+		SquareToTriangle8(&u0[ii], &u1[ii], x, y);
+	}, results);
+	return agree;
+}
+
+bool WriteCsv(std::vector<BenchResult> const& results, char const* path) {
+	FILE* file = OpenFile(path, "w");
+	if (!file) {
+		return false;
+	}
+	fprintf(file, "kernel,scene,primitives,calls,hits,min_ns,p10_ns,median_ns,p90_ns,max_ns\n");
+	for (BenchResult const& r : results) {
+		fprintf(file, "%s,%s,%d,%llu,%llu,%.3f,%.3f,%.3f,%.3f,%.3f\n", r.mKernel.c_str(), r.mScene.c_str(), r.mPrimitives,
+			(unsigned long long)r.mCalls, (unsigned long long)r.mHits, r.mMin, r.mP10, r.mMedian, r.mP90, r.mMax);
+	}
+	fclose(file);
+	return true;
+}
+
+bool WriteJson(std::vector<BenchResult> const& results, char const* path) {
+	FILE* file = OpenFile(path, "w");
+	if (!file) {
+		return false;
+	}
+	fprintf(file, "{\n\t\"warmup_passes\": %d,\n\t\"repetitions\": %d,\n\t\"vec_isa\": %d,\n\t\"packet_size\": %d,\n\t\"results\": [\n",
+		warmup_passes, repetitions, VEC_ISA, PACKET_SIZE);
+	for (size_t ii = 0; ii < results.size(); ++ii) {
+		BenchResult const& r = results[ii];
+		fprintf(file, "\t\t{ \"kernel\": \"%s\", \"scene\": \"%s\", \"primitives\": %d, \"calls\": %llu, \"hits\": %llu, ",
+			r.mKernel.c_str(), r.mScene.c_str(), r.mPrimitives, (unsigned long long)r.mCalls, (unsigned long long)r.mHits);
+		fprintf(file, "\"ns_per_call\": { \"min\": %.3f, \"p10\": %.3f, \"median\": %.3f, \"p90\": %.3f, \"max\": %.3f } }%s\n",
+			r.mMin, r.mP10, r.mMedian, r.mP90, r.mMax, ii + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "\t]\n}\n");
+	fclose(file);
+	return true;
+}
+
+void PrintUsage() {
+	printf("benchmark [--warmup N] [--reps N] [--rays N] [--primitives N] [--traversal-rays N] [--warp-samples N]\n");
+	printf("          [--models DIR] [--csv PATH] [--json PATH] [--only KERNEL]\n");
+}
+
+int main(int argc, char** argv) {
+	std::string only;
+	for (int ii = 1; ii < argc; ++ii) {
+		std::string const arg = argv[ii];
+		if (arg == "--help" || ii + 1 >= argc) {
+			PrintUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+		char const* value = argv[++ii];
+		if (arg == "--warmup") warmup_passes = atoi(value);
+		else if (arg == "--reps") repetitions = std::max(atoi(value), 1);
+		else if (arg == "--rays") ray_count = std::max(atoi(value), 1);
+		else if (arg == "--primitives") primitive_count = std::max(atoi(value), 1);
+		else if (arg == "--traversal-rays") traversal_ray_count = std::max(atoi(value), 1);
+		else if (arg == "--warp-samples") warp_sample_count = std::max(atoi(value), 1);
+		else if (arg == "--models") models_dir = std::string(value) + "/";
+		else if (arg == "--csv") csv_path = value;
+		else if (arg == "--json") json_path = value;
+		else if (arg == "--only") only = value;
+		else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::vector<BenchResult> results;
+	if (only.empty() || only == "primitives") {
+		BenchPrimitives(results);
+	}
+	if (only.empty() || only == "traversal") {
+		for (char const* name : kModels) {
+			BenchModel(name, results);
+		}
+	}
+
+	bool warpsAgree = true;
+	if (only.empty() || only == "warps") {
+		warpsAgree = BenchWarps(results);
+	}
+
+	if (!WriteCsv(results, csv_path.c_str())) {
+		printf("Could not write %s\n", csv_path.c_str());
+	}
+	if (!WriteJson(results, json_path.c_str())) {
+		printf("Could not write %s\n", json_path.c_str());
+	}
+	if (!warpsAgree) {
+		printf("The 8 wide warps disagree with the scalar ones\n");
+		return 1;
+	}
+	return 0;
+}
\ No newline at end of file
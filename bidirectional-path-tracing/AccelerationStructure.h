@@ -24,7 +24,7 @@ public:
 	{
 		HitRecord temp_record;
 		bool hit_anything = false;
-		double closest = t_max;
+		float closest = t_max;
 		for (int ii = 0; ii < list_size; ++ii) {
 			if (list[ii]->Hit(r, t_min, closest, temp_record)) {
 				hit_anything = true;
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+size_t const kArenaBlockSize = 1 << 20;
+size_t const kArenaHugePageSize = 2 << 20;
+
+// Monotonic allocator that owns a scene. Allocations are bumped out of large blocks so nodes built together sit
+// together in memory, nothing is freed on its own and deleting the arena frees everything at once. Destructors
+// only run for types that need them, in reverse order of construction. Loading jobs on several threads can
+// allocate from the same arena at once
+class Arena {
+public:
+	// hugePages uses 2MB blocks aligned to 2MB and asks the kernel to back them with huge pages where it can
+	Arena(bool const hugePages = false) : mHugePages(hugePages), mBlockSize(hugePages ? kArenaHugePageSize : kArenaBlockSize),
+		mBlocks(nullptr), mCurrent(nullptr), mEnd(nullptr), mFinalizers(nullptr), mAllocated(0), mReserved(0) {}
+
+	~Arena() {
+		Reset();
+	}
+
+	Arena(Arena const&) = delete;
+	Arena& operator=(Arena const&) = delete;
+
+	void* Allocate(size_t const size, size_t const align) {
+		std::lock_guard<std::mutex> lock(mLock);
+		return Bump(size, align);
+	}
+
+	template <typename T, typename... Args>
+	T* New(Args&&... args) {
+		// Constructed outside the lock, constructors may allocate from the arena themselves
+		T* object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if (!std::is_trivially_destructible<T>::value) {
+			std::lock_guard<std::mutex> lock(mLock);
+			Finalizer* finalizer = (Finalizer*)Bump(sizeof(Finalizer), alignof(Finalizer));
+			finalizer->mDestroy = [](void* p) { ((T*)p)->~T(); };
+			finalizer->mObject = object;
+			finalizer->mNext = mFinalizers;
+			mFinalizers = finalizer;
+		}
+		return object;
+	}
+
+	// Default constructed, only for types that don't need destroying
+	template <typename T>
+	T* NewArray(size_t const count) {
+		static_assert(std::is_trivially_destructible<T>::value, "Arena arrays are never destroyed");
+		T* array = (T*)Allocate(sizeof(T) * (count > 0 ? count : 1), alignof(T));
+		for (size_t ii = 0; ii < count; ++ii) {
+			new (&array[ii]) T();
+		}
+		return array;
+	}
+
+	// Destroy everything and give the memory back
+	void Reset() {
+		for (Finalizer* finalizer = mFinalizers; finalizer; finalizer = finalizer->mNext) {
+			finalizer->mDestroy(finalizer->mObject);
+		}
+		mFinalizers = nullptr;
+
+		while (mBlocks) {
+			Block* next = mBlocks->mNext;
+			FreeBlock(mBlocks);
+			mBlocks = next;
+		}
+		mCurrent = nullptr;
+		mEnd = nullptr;
+		mAllocated = 0;
+		mReserved = 0;
+	}
+
+	size_t BytesAllocated() const { return mAllocated; }
+	size_t BytesReserved() const { return mReserved; }
+
+private:
+	struct Block {
+		Block* mNext;
+		size_t mSize;
+	};
+
+	struct Finalizer {
+		void (*mDestroy)(void*);
+		void* mObject;
+		Finalizer* mNext;
+	};
+
+	void* Bump(size_t const size, size_t const align) {
+		uintptr_t aligned = ((uintptr_t)mCurrent + (align - 1)) & ~(uintptr_t)(align - 1);
+		if (!mCurrent || aligned + size > (uintptr_t)mEnd) {
+			NewBlock(size + align);
+			aligned = ((uintptr_t)mCurrent + (align - 1)) & ~(uintptr_t)(align - 1);
+		}
+		mCurrent = (char*)(aligned + size);
+		mAllocated += size;
+		return (void*)aligned;
+	}
+
+	// Anything too big for a normal block gets one of its own
+	void NewBlock(size_t const minSize) {
+		size_t size = mBlockSize;
+		while (size < minSize + sizeof(Block)) {
+			size += mBlockSize;
+		}
+
+		Block* block = (Block*)AllocateBlock(size);
+		if (!block) {
+			throw std::bad_alloc();
+		}
+		block->mNext = mBlocks;
+		block->mSize = size;
+		mBlocks = block;
+		mCurrent = (char*)block + sizeof(Block);
+		mEnd = (char*)block + size;
+		mReserved += size;
+	}
+
+	void* AllocateBlock(size_t const size) {
+		if (!mHugePages) {
+			return malloc(size);
+		}
+#if defined(_WIN32)
+		// Large pages need SeLockMemoryPrivilege, aligned blocks are the part that doesn't
+		return _aligned_malloc(size, kArenaHugePageSize);
+#else
+		void* block = aligned_alloc(kArenaHugePageSize, size);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+		if (block) {
+			madvise(block, size, MADV_HUGEPAGE);
+		}
+#endif
+		return block;
+#endif
+	}
+
+	void FreeBlock(Block* block) {
+#if defined(_WIN32)
+		if (mHugePages) {
+			_aligned_free(block);
+			return;
+		}
+#endif
+		free(block);
+	}
+
+	bool const mHugePages;
+	size_t const mBlockSize;
+	Block* mBlocks;
+	char* mCurrent;
+	char* mEnd;
+	Finalizer* mFinalizers;
+	size_t mAllocated;
+	size_t mReserved;
+	std::mutex mLock;
+};
\ No newline at end of file
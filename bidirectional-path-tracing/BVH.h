@@ -1,145 +1,310 @@
 #pragma once
 
 #include "AccelerationStructure.h"
-#include "triangle.h"
+#include "Arena.h"
+#include "VertexBuffer.h"
 #include <algorithm>
 #include <vector>
 #include "Box.h"
 
-int const minElementsPerLeaf = 3;
+// Leaves end up with 3 to 5 triangles, which keeps nodes to about 0.45 a triangle without slowing traversal
+int const minElementsPerLeaf = 5;
 int const maxBVHDepth = 100;
 
-bool compareTrianglesX(Triangle* first, Triangle* second) {
-	return first->mBoundingBox.mMin.x() < second->mBoundingBox.mMin.x();
-}
-bool compareTrianglesY(Triangle* first, Triangle* second) {
-	return first->mBoundingBox.mMin.y() < second->mBoundingBox.mMin.y();
-}
-bool compareTrianglesZ(Triangle* first, Triangle* second) {
-	return first->mBoundingBox.mMin.z() < second->mBoundingBox.mMin.z();
-}
+// What intersecting one triangle needs, a vertex and the two edges from it. 36 bytes
+struct BVHTriangle {
+	float mA[3];
+	float mAB[3];
+	float mAC[3];
+};
 
+// Nodes are stored depth first in one array, so the left child of an interior node is the next one. No pointers,
+// so the array can be written to and mapped from a scene cache as it is. 32 bytes, two to a cache line, the bounds
+// are plain floats because a Box of SIMD vectors pads each corner to 16 bytes
+struct BVHNode {
+	float mMin[3];
+	float mMax[3];
+	uint32_t mOffset; // First triangle of a leaf, index of the right child otherwise
+	uint16_t mCount; // Triangles in a leaf, 0 for interior nodes
+	uint16_t mSplitAxis;
+
+	bool IsLeaf() const { return mCount > 0; }
+
+	Box Bounds() const {
+		return Box(Vec3(mMin[0], mMin[1], mMin[2]), Vec3(mMax[0], mMax[1], mMax[2]));
+	}
+
+	void SetBounds(Box const& box) {
+		for (int axis = 0; axis < 3; ++axis) {
+			mMin[axis] = box.mMin[axis];
+			mMax[axis] = box.mMax[axis];
+		}
+	}
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode is meant to be half a cache line");
+
+// Triangles of an indexed mesh, referenced by index while building. The only per triangle data kept is
+// mTriangles, sorted so every leaf's triangles are next to each other. Nodes and triangles live in arena
 class BVH : public AccelerationStructure {
 public:
-	BVH() {
-		mDepth = 0;
-		mRight = nullptr;
-		mLeft = nullptr;
-		mElementsCount = 0;
-		mElements = nullptr;
+	BVH(VertexBuffer const& vertices, uint32_t const* indices, uint32_t const indexCount, Arena& arena) : mNodes(nullptr), mNodeCount(0), mTriangles(nullptr), mTriangleCount(0) {
+		uint32_t const count = indexCount / 3;
+		if (count == 0) {
+			return;
+		}
+
+		std::vector<uint32_t> order(count);
+		std::vector<Box> bounds(count);
+		for (uint32_t ii = 0; ii < count; ++ii) {
+			order[ii] = ii;
+			bounds[ii].Expand(vertices.Position(indices[3 * ii]));
+			bounds[ii].Expand(vertices.Position(indices[3 * ii + 1]));
+			bounds[ii].Expand(vertices.Position(indices[3 * ii + 2]));
+		}
+		std::vector<BVHNode> nodes;
+		nodes.reserve(2 * count / ((minElementsPerLeaf + 1) / 2) + 1);
+		Build(order.data(), 0, count, bounds, 0, nodes);
+		mNodes = arena.NewArray<BVHNode>(nodes.size());
+		mNodeCount = (uint32_t)nodes.size();
+		std::copy(nodes.begin(), nodes.end(), mNodes);
+		mBoundingBox = mNodes[0].Bounds();
+
+		mTriangles = arena.NewArray<BVHTriangle>(count);
+		mTriangleCount = count;
+		for (uint32_t ii = 0; ii < count; ++ii) {
+			uint32_t const* face = &indices[3 * order[ii]];
+			Vec3 const a = vertices.Position(face[0]);
+			Vec3 const ab = vertices.Position(face[1]) - a;
+			Vec3 const ac = vertices.Position(face[2]) - a;
+			for (int axis = 0; axis < 3; ++axis) {
+				mTriangles[ii].mA[axis] = a[axis];
+				mTriangles[ii].mAB[axis] = ab[axis];
+				mTriangles[ii].mAC[axis] = ac[axis];
+			}
+		}
 	}
 
-	BVH(std::vector<Triangle*> const& inElements, int const d) : mDepth(d) {
-		mElementsCount = inElements.size();
-		mElements = new Triangle*[mElementsCount];
-		for (int ii = 0; ii < inElements.size(); ++ii) {
-			mBoundingBox.Expand(inElements[ii]->mBoundingBox);
-			mElements[ii] = inElements[ii];
+	// Arrays that are already built, like ones mapped from a scene cache. They must outlive the BVH
+	BVH(BVHNode* nodes, uint32_t const nodeCount, BVHTriangle* triangles, uint32_t const triangleCount)
+		: mNodes(nodeCount > 0 ? nodes : nullptr), mNodeCount(nodeCount), mTriangles(triangles), mTriangleCount(triangleCount) {
+		if (mNodes) {
+			mBoundingBox = mNodes[0].Bounds();
 		}
+	}
+
+	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const
+	{
+		if (!mNodes) {
+			return false;
+		}
+
+		// The hit point and normal are only worked out for the closest triangle
+		float closest = t_max;
+		uint32_t triangle = 0;
+		if (!HitNode(mNodes, r, t_min, closest, triangle)) {
+			return false;
+		}
+		rec.t = closest;
+		rec.p = r.point_at_parameter(closest);
+		rec.normal = TriangleNormal(triangle);
+		return true;
+	}
+
+	// Lanes that miss a node drop out, the node is skipped once none are left
+	virtual uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		if (!mNodes) {
+			return 0;
+		}
+
+		uint32_t triangle[PACKET_SIZE];
+		uint32_t const hit = HitNodePacket(mNodes, packet, t_min, rec, mask, triangle);
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			if (hit & (1u << ii)) {
+				HitRecord& laneRec = rec.rec[ii];
+				laneRec.t = rec.t[ii];
+				laneRec.p = Vec3(packet.mOriginX[ii], packet.mOriginY[ii], packet.mOriginZ[ii]) + rec.t[ii] * Vec3(packet.mDirX[ii], packet.mDirY[ii], packet.mDirZ[ii]);
+				laneRec.normal = TriangleNormal(triangle[ii]);
+			}
+		}
+		return hit;
+	}
+
+	BVHNode* mNodes; // Root first
+	uint32_t mNodeCount;
+	BVHTriangle* mTriangles;
+	uint32_t mTriangleCount;
+
+private:
+	// Split in half along the major axis of the bounding box, sorted by the lower side of each triangle
+	void Build(uint32_t* order, uint32_t const first, uint32_t const count, std::vector<Box> const& bounds, int const depth, std::vector<BVHNode>& nodes) {
+		size_t const index = nodes.size();
+		nodes.push_back(BVHNode());
+		Box box;
+		for (uint32_t ii = first; ii < first + count; ++ii) {
+			box.Expand(bounds[order[ii]]);
+		}
+		nodes[index].SetBounds(box);
 
 		// Determine this is a leaf node
-		if (mElementsCount <= minElementsPerLeaf || mDepth > maxBVHDepth) {
-			mIsLeaf = true;
+		if (count <= (uint32_t)minElementsPerLeaf || depth > maxBVHDepth) {
+			nodes[index].mOffset = first;
+			nodes[index].mCount = (uint16_t)count;
+			nodes[index].mSplitAxis = X_AXIS;
 			return;
 		}
 
-		// Split the tree into 2 children accross the major axis of the bounding box
-		// Need to find a better method to split evenly
-		mIsLeaf = false;
-		Vec3 const& center = mBoundingBox.Center();
-		int const majorAxis = mBoundingBox.GetMajorAxis();
-
-		// Sort smallest to largest
-		switch (majorAxis) {
-		case X_AXIS:
-			std::sort(mElements, mElements + mElementsCount, compareTrianglesX);
-			break;
-		case Y_AXIS:
-			std::sort(mElements, mElements + mElementsCount, compareTrianglesY);
-			break;
-		case Z_AXIS:
-			std::sort(mElements, mElements + mElementsCount, compareTrianglesZ);
-			break;
-		}
-
-		std::vector<Triangle*> temp[2];
-		for (int ii = 0; ii < mElementsCount; ++ii) {
-			if (ii < mElementsCount / 2) { // Split in half
-				temp[0].push_back(inElements[ii]);
-			} else {
-				temp[1].push_back(inElements[ii]);
-			}
+		// Left holds the lower half along the axis, which lets traversal visit the nearer child first
+		int const majorAxis = box.GetMajorAxis();
+		std::sort(order + first, order + first + count, [&](uint32_t const a, uint32_t const b) {
+			return bounds[a].mMin[majorAxis] < bounds[b].mMin[majorAxis];
+		});
+		Build(order, first, count / 2, bounds, depth + 1, nodes);
+		uint32_t const right = (uint32_t)nodes.size();
+		Build(order, first + count / 2, count - count / 2, bounds, depth + 1, nodes);
+		nodes[index].mOffset = right;
+		nodes[index].mCount = 0;
+		nodes[index].mSplitAxis = (uint16_t)majorAxis;
+	}
+
+	// Moller-Trumbore, only needs the edges so nothing else is stored per triangle
+	bool HitTriangle(uint32_t const index, Ray const& r, float const t_min, float const t_max, float& t) const {
+		STAT_INC(kTriangleTests);
+
+		BVHTriangle const& tri = mTriangles[index];
+		Vec3 const ab(tri.mAB[0], tri.mAB[1], tri.mAB[2]);
+		Vec3 const ac(tri.mAC[0], tri.mAC[1], tri.mAC[2]);
+		Vec3 const p = cross(r.direction(), ac);
+		float const det = dot(ab, p);
+		if (det == 0.f) {
+			return false;
 		}
+		float const invDet = 1.f / det;
 
-		if (temp[0].size() > 0) {
-			mLeft = new BVH(temp[0], mDepth + 1);
-		} else {
-			mLeft = nullptr;
+		Vec3 const toOrigin = r.origin() - Vec3(tri.mA[0], tri.mA[1], tri.mA[2]);
+		float const u = dot(toOrigin, p) * invDet;
+		if (u < 0.f || u > 1.f) {
+			return false;
 		}
-		if (temp[1].size() > 0) {
-			mRight = new BVH(temp[1], mDepth + 1);
-		} else {
-			mRight = nullptr;
+		Vec3 const q = cross(toOrigin, ab);
+		float const v = dot(r.direction(), q) * invDet;
+		if (v < 0.f || u + v > 1.f) {
+			return false;
 		}
+
+		float const tHit = dot(ac, q) * invDet;
+		if (tHit > t_max || tHit < t_min) {
+			return false;
+		}
+		t = tHit;
+		return true;
 	}
 
-	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const
-	{
+	Vec3 TriangleNormal(uint32_t const index) const {
+		BVHTriangle const& tri = mTriangles[index];
+		return normalize(cross(Vec3(tri.mAB[0], tri.mAB[1], tri.mAB[2]), Vec3(tri.mAC[0], tri.mAC[1], tri.mAC[2])));
+	}
+
+	// closest comes in as t_max and leaves as the nearest hit, with its triangle
+	bool HitNode(BVHNode const* node, Ray const& r, float const t_min, float& closest, uint32_t& triangle) const {
+		STAT_INC(kBVHNodes);
+
 		// Check if volume is hit at all
-		if (!HitBB(r)) {
+		if (!node->Bounds().Intersects(r, t_min, closest)) {
 			return false;
 		}
 
-		HitRecord temp_record;
 		bool hit_anything = false;
-		double closest = t_max;
-
-		// Loop through all elements if this is a leaf
-		if (mIsLeaf) {
-			for (int ii = 0; ii < mElementsCount; ++ii) {
-				if (mElements[ii]->Hit(r, t_min, closest, temp_record)) {
-
+		if (node->IsLeaf()) {
+			for (uint32_t ii = node->mOffset; ii < node->mOffset + node->mCount; ++ii) {
+				float t;
+				if (HitTriangle(ii, r, t_min, closest, t)) {
 					hit_anything = true;
-					closest = temp_record.t;
-					rec = temp_record;
+					closest = t;
+					triangle = ii;
 				}
 			}
 		} else {
-			// Call children.hit otherwise
-			if (mLeft) {
-				if (mLeft->Hit(r, t_min, closest, temp_record)) {
-					hit_anything = true;
-					closest = temp_record.t;
-					rec = temp_record;
-				}
-			}
-			if (mRight) {
-				if (mRight->Hit(r, t_min, closest, temp_record)) {
-					hit_anything = true;
-					closest = temp_record.t;
-					rec = temp_record;
-				}
-			}
+			// Call the nearer child first so its hit can cull the other
+			BVHNode const* left = node + 1;
+			BVHNode const* right = mNodes + node->mOffset;
+			BVHNode const* near = r.sign[node->mSplitAxis] ? right : left;
+			BVHNode const* far = r.sign[node->mSplitAxis] ? left : right;
+			hit_anything |= HitNode(near, r, t_min, closest, triangle);
+			hit_anything |= HitNode(far, r, t_min, closest, triangle);
 		}
-
 		return hit_anything;
 	}
 
-	virtual void Translate(Vec3 const& trans) {
-		Object::Translate(trans);
-		if (mLeft) {
-			mLeft->Translate(trans);
+	// Same test as HitTriangle() for every lane at once
+	uint32_t HitTrianglePacket(uint32_t const index, RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask, uint32_t* triangle) const {
+		STAT_ADD(kTriangleTests, LaneCount(mask));
+
+		BVHTriangle const& tri = mTriangles[index];
+		float const ax = tri.mA[0], ay = tri.mA[1], az = tri.mA[2];
+		float const abx = tri.mAB[0], aby = tri.mAB[1], abz = tri.mAB[2];
+		float const acx = tri.mAC[0], acy = tri.mAC[1], acz = tri.mAC[2];
+
+		float tHit[PACKET_SIZE];
+		int laneHit[PACKET_SIZE];
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			float const dx = packet.mDirX[ii], dy = packet.mDirY[ii], dz = packet.mDirZ[ii];
+			float const px = dy * acz - dz * acy;
+			float const py = dz * acx - dx * acz;
+			float const pz = dx * acy - dy * acx;
+			float const det = abx * px + aby * py + abz * pz;
+			float const invDet = 1.f / det;
+
+			float const ox = packet.mOriginX[ii] - ax;
+			float const oy = packet.mOriginY[ii] - ay;
+			float const oz = packet.mOriginZ[ii] - az;
+			float const u = (ox * px + oy * py + oz * pz) * invDet;
+			float const qx = oy * abz - oz * aby;
+			float const qy = oz * abx - ox * abz;
+			float const qz = ox * aby - oy * abx;
+			float const v = (dx * qx + dy * qy + dz * qz) * invDet;
+			float const t = (acx * qx + acy * qy + acz * qz) * invDet;
+
+			tHit[ii] = t;
+			laneHit[ii] = (det != 0.f) & (u >= 0.f) & (u <= 1.f) & (v >= 0.f) & (u + v <= 1.f) & (t >= t_min) & (t <= rec.t[ii]);
+		}
+
+		uint32_t hit = 0;
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			hit |= (uint32_t)laneHit[ii] << ii;
 		}
-		if (mRight) {
-			mRight->Translate(trans);
+		hit &= mask;
+
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			if (hit & (1u << ii)) {
+				rec.t[ii] = tHit[ii];
+				triangle[ii] = index;
+			}
 		}
+		return hit;
 	}
 
-	bool mIsLeaf;
-	Triangle** mElements;
-	int mElementsCount;
+	uint32_t HitNodePacket(BVHNode const* node, RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask, uint32_t* triangle) const {
+		STAT_ADD(kBVHNodes, LaneCount(mask));
+
+		uint32_t const active = node->Bounds().HitPacket(packet, t_min, rec.t, mask);
+		if (!active) {
+			return 0;
+		}
 
-	int mDepth;
-	BVH* mLeft;
-	BVH* mRight;
+		uint32_t hit = 0;
+		if (node->IsLeaf()) {
+			for (uint32_t ii = node->mOffset; ii < node->mOffset + node->mCount; ++ii) {
+				hit |= HitTrianglePacket(ii, packet, t_min, rec, active, triangle);
+			}
+		} else {
+			BVHNode const* left = node + 1;
+			BVHNode const* right = mNodes + node->mOffset;
+			BVHNode const* near = packet.mSign[node->mSplitAxis] ? right : left;
+			BVHNode const* far = packet.mSign[node->mSplitAxis] ? left : right;
+			hit |= HitNodePacket(near, packet, t_min, rec, active, triangle);
+			hit |= HitNodePacket(far, packet, t_min, rec, active, triangle);
+		}
+		return hit;
+	}
 };
\ No newline at end of file
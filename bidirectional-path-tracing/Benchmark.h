@@ -0,0 +1,40 @@
+#pragma once
+
+#include <math.h>
+#include "vec3.h"
+
+// What main does with the scene once it's loaded
+enum RunMode {
+	kRunRender, // One image at samples_per_pixel
+	kRunConvergence, // Error against a reference at wall clock checkpoints, written to convergence.csv
+	kRunScaling, // Render time at 1, 2, 4 ... threads, written to scaling.csv and scaling_threads.csv
+};
+
+char const* const kRunModeNames[] = { "render", "convergence", "scaling" };
+
+// Error of an image against a reference, both linear radiance
+struct ImageError {
+	double mRmse;
+	double mRelMse;
+};
+
+// image is a sum of samples so it's scaled on the way. relMSE adds a little to the denominator so black
+// pixels don't dominate it
+inline ImageError CompareImages(Vec3 const* image, float const imageScale, Vec3 const* reference, int const pixelCount) {
+	double squared = 0.0;
+	double relative = 0.0;
+	for (int ii = 0; ii < pixelCount; ++ii) {
+		Vec3 const value = image[ii] * imageScale;
+		for (int channel = 0; channel < 3; ++channel) {
+			double const ref = reference[ii][channel];
+			double const diff = value[channel] - ref;
+			squared += diff * diff;
+			relative += diff * diff / (ref * ref + 0.01);
+		}
+	}
+
+	ImageError error;
+	error.mRmse = sqrt(squared / (3.0 * pixelCount));
+	error.mRelMse = relative / (3.0 * pixelCount);
+	return error;
+}
\ No newline at end of file
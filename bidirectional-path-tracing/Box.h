@@ -14,7 +14,7 @@ public:
 	}
 	Box(Vec3 const& min, Vec3 const& max) : mMin(min), mMax(max) {}
 
-	Vec3 Center() {
+	Vec3 Center() const {
 		return (mMax + mMin) / 2.f;
 	}
 
@@ -36,7 +36,7 @@ public:
 			fminf(other.mMin.z(), mMin.z()));
 	}
 
-	Vec3 GetSize() {
+	Vec3 GetSize() const {
 		return mMax - mMin;
 	}
 
@@ -55,49 +55,65 @@ public:
 	}
 
 	bool Hit(Ray const& r) const {
-		float tmin, tmax, tymin, tymax;
-
-		if (r.sign[0]) {
-			tmin = (mMin.x() - r.origin().x()) * r.invDir.x();
-			tmax = (mMax.x() - r.origin().x()) * r.invDir.x();
-		} else { // Swapped order
-			tmax = (mMin.x() - r.origin().x()) * r.invDir.x();
-			tmin = (mMax.x() - r.origin().x()) * r.invDir.x();
-		}
-
-		if (r.sign[1]) {
-			tymin = (mMin.y() - r.origin().y()) * r.invDir.y();
-			tymax = (mMax.y() - r.origin().y()) * r.invDir.y();
-		} else { // Swapped order
-			tymax = (mMin.y() - r.origin().y()) * r.invDir.y();
-			tymin = (mMax.y() - r.origin().y()) * r.invDir.y();
-		}
-		
-		if (tmin > tymax || tymin > tmax) {
-			return false;
-		}
+		return Intersects(r, r.tMin, r.tMax);
+	}
 
-		tmin = fmax(tymin, tmin);
-		tmax = fmin(tmax, tymax);
+	// Returns the entry and exit distances along the ray
+	bool Hit(Ray const& r, float& tmin, float& tmax) const {
+		STAT_INC(kBoxTests);
+		Vec3 const t0 = mulSub(mMin, r.invDir, r.originInvDir);
+		Vec3 const t1 = mulSub(mMax, r.invDir, r.originInvDir);
+		tmin = componentMin(t0, t1).maxComponent();
+		tmax = componentMax(t0, t1).minComponent();
+		return tmin <= tmax;
+	}
 
-		float tzmin, tzmax;
+	// Whether the ray passes through the box somewhere between t_min and t_max
+	bool Intersects(Ray const& r, float const t_min, float const t_max) const {
+		STAT_INC(kBoxTests);
+		Vec3 const t0 = mulSub(mMin, r.invDir, r.originInvDir);
+		Vec3 const t1 = mulSub(mMax, r.invDir, r.originInvDir);
+		float const tNear = componentMin(t0, t1).maxComponent();
+		float const tFar = componentMax(t0, t1).minComponent();
+		return (tNear > t_min ? tNear : t_min) <= (tFar < t_max ? tFar : t_max);
+	}
 
-		if (r.sign[2]) {
-			tzmin = (mMin.z() - r.origin().z()) * r.invDir.z();
-			tzmax = (mMax.z() - r.origin().z()) * r.invDir.z();
-		} else { // Swapped order
-			tzmax = (mMin.z() - r.origin().z()) * r.invDir.z();
-			tzmin = (mMax.z() - r.origin().z()) * r.invDir.z();
+	// Mask of the lanes in mask whose ray enters the box between t_min and their own t_max
+	uint32_t HitPacket(RayPacket const& packet, float const t_min, float const* t_max, uint32_t const mask) const {
+		STAT_ADD(kBoxTests, LaneCount(mask));
+		float const minX = mMin.x(), minY = mMin.y(), minZ = mMin.z();
+		float const maxX = mMax.x(), maxY = mMax.y(), maxZ = mMax.z();
+
+		// Plain compares rather than fmin/fmax so the lane loop vectorizes
+		int laneHit[PACKET_SIZE];
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			float const tx0 = minX * packet.mInvDirX[ii] - packet.mOriginInvDirX[ii];
+			float const tx1 = maxX * packet.mInvDirX[ii] - packet.mOriginInvDirX[ii];
+			float const ty0 = minY * packet.mInvDirY[ii] - packet.mOriginInvDirY[ii];
+			float const ty1 = maxY * packet.mInvDirY[ii] - packet.mOriginInvDirY[ii];
+			float const tz0 = minZ * packet.mInvDirZ[ii] - packet.mOriginInvDirZ[ii];
+			float const tz1 = maxZ * packet.mInvDirZ[ii] - packet.mOriginInvDirZ[ii];
+
+			float tNear = tx0 < tx1 ? tx0 : tx1;
+			float tFar = tx0 < tx1 ? tx1 : tx0;
+			float const tyNear = ty0 < ty1 ? ty0 : ty1;
+			float const tyFar = ty0 < ty1 ? ty1 : ty0;
+			float const tzNear = tz0 < tz1 ? tz0 : tz1;
+			float const tzFar = tz0 < tz1 ? tz1 : tz0;
+			tNear = tNear > tyNear ? tNear : tyNear;
+			tNear = tNear > tzNear ? tNear : tzNear;
+			tNear = tNear > t_min ? tNear : t_min;
+			tFar = tFar < tyFar ? tFar : tyFar;
+			tFar = tFar < tzFar ? tFar : tzFar;
+			tFar = tFar < t_max[ii] ? tFar : t_max[ii];
+			laneHit[ii] = tNear <= tFar;
 		}
 
-		if (tmin > tzmax || tzmin > tmax) {
-			return false;
+		uint32_t hit = 0;
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			hit |= (uint32_t)laneHit[ii] << ii;
 		}
-
-		tmin = fmax(tmin, tzmin);
-		tmax = fmin(tmax, tzmax); // Need to return these values
-
-		return true;
+		return hit & mask;
 	}
 
 	void Translate(Vec3 const& trans) {
@@ -0,0 +1,348 @@
+#pragma once
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "vec3.h"
+#include "util.h"
+#include "3rd_party/stb/stb_image_write.h"
+
+// Channels a film keeps besides its color, and writes to EXR files along with it
+enum FilmChannels {
+	kFilmColor = 0,
+	kFilmSampleCount = 1 << 0, // Samples each pixel took, which differ between tiles once there's a time budget
+	kFilmVariance = 1 << 1, // Variance of each pixel's mean, from the spread of its samples
+};
+
+enum ExrPixelType {
+	kExrHalf,
+	kExrFloat,
+};
+
+char const* const kExrPixelNames[] = { "half", "float" };
+
+// Nearest half to value, ties to even. Too big is infinity and too small is zero
+inline uint16_t FloatToHalf(float const value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint32_t const sign = (bits >> 16) & 0x8000;
+	uint32_t const exponent = (bits >> 23) & 0xff;
+	uint32_t mantissa = bits & 0x7fffff;
+	if (exponent == 0xff) {
+		return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	}
+
+	int const halfExponent = (int)exponent - 127 + 15;
+	if (halfExponent >= 31) {
+		return (uint16_t)(sign | 0x7c00);
+	}
+	int shift = 13;
+	uint32_t half;
+	if (halfExponent <= 0) {
+		if (halfExponent < -10) {
+			return (uint16_t)sign;
+		}
+		// Denormal, the implicit bit becomes part of the mantissa
+		mantissa |= 0x800000;
+		shift = 14 - halfExponent;
+		half = mantissa >> shift;
+	}
+	else {
+		half = ((uint32_t)halfExponent << 10) | (mantissa >> shift);
+	}
+	// Rounding up can carry into the exponent, which is still the right answer
+	uint32_t const rest = mantissa & ((1u << shift) - 1);
+	uint32_t const halfway = 1u << (shift - 1);
+	if (rest > halfway || (rest == halfway && (half & 1))) {
+		++half;
+	}
+	return (uint16_t)(sign | half);
+}
+
+// Linear radiance of every pixel, kept as sums of samples so renders of the same image can be merged and tone
+// mapped later without losing range. Pixels are top row first. Render threads each add to their own pixels
+class Film {
+public:
+	Film(int const width, int const height, int const channels = kFilmColor) : mWidth(width), mHeight(height), mChannels(channels),
+		mPixels(width * height * 4, 0.f), mSquares((channels & kFilmVariance) ? width * height * 3 : 0, 0.f) {}
+
+	// sum and sumSquares are over count samples of pixel (x, y). sumSquares is only used with kFilmVariance
+	void AddSamples(int const x, int const y, Vec3 const& sum, Vec3 const& sumSquares, int const count) {
+		int const pixel = y * mWidth + x;
+		float* rgba = &mPixels[pixel * 4];
+		rgba[0] += sum.r();
+		rgba[1] += sum.g();
+		rgba[2] += sum.b();
+		rgba[3] += (float)count;
+		if (!mSquares.empty()) {
+			mSquares[pixel * 3] += sumSquares.r();
+			mSquares[pixel * 3 + 1] += sumSquares.g();
+			mSquares[pixel * 3 + 2] += sumSquares.b();
+		}
+	}
+
+	// Add another render of the same image, like one from another machine or an earlier run
+	bool Merge(Film const& other) {
+		if (other.mWidth != mWidth || other.mHeight != mHeight || other.mSquares.size() != mSquares.size()) {
+			printf("Films of %dx%d and %dx%d, or with different channels, can't be merged\n", mWidth, mHeight, other.mWidth, other.mHeight);
+			return false;
+		}
+		for (size_t ii = 0; ii < mPixels.size(); ++ii) {
+			mPixels[ii] += other.mPixels[ii];
+		}
+		for (size_t ii = 0; ii < mSquares.size(); ++ii) {
+			mSquares[ii] += other.mSquares[ii];
+		}
+		return true;
+	}
+
+	int Samples(int const x, int const y) const { return (int)mPixels[(y * mWidth + x) * 4 + 3]; }
+
+	Vec3 Mean(int const x, int const y) const {
+		float const* rgba = &mPixels[(y * mWidth + x) * 4];
+		if (rgba[3] <= 0.f) {
+			return Vec3(0, 0, 0);
+		}
+		return Vec3(rgba[0], rgba[1], rgba[2]) / rgba[3];
+	}
+
+	// Pixels nothing has been rendered to yet are transparent
+	float Alpha(int const x, int const y) const { return mPixels[(y * mWidth + x) * 4 + 3] > 0.f ? 1.f : 0.f; }
+
+	// Variance of the mean, 0 without kFilmVariance or with fewer than two samples
+	Vec3 Variance(int const x, int const y) const {
+		int const pixel = y * mWidth + x;
+		float const count = mPixels[pixel * 4 + 3];
+		if (mSquares.empty() || count < 2.f) {
+			return Vec3(0, 0, 0);
+		}
+		Vec3 const mean = Mean(x, y);
+		float variance[3];
+		for (int channel = 0; channel < 3; ++channel) {
+			// Rounding can take a pixel that barely varies below zero
+			float const squares = mSquares[pixel * 3 + channel] - count * mean[channel] * mean[channel];
+			variance[channel] = fmax(squares, 0.f) / ((count - 1.f) * count);
+		}
+		return Vec3(variance[0], variance[1], variance[2]);
+	}
+
+	// The display image, clamped and gamma corrected
+	void ToImage(int8_t* data, int const bytesPerPixel) const {
+		for (int y = 0; y < mHeight; ++y) {
+			for (int x = 0; x < mWidth; ++x) {
+				Vec3 color = Mean(x, y);
+
+				// Lights are far brighter than the display range
+				color.clamp();
+
+				// Adjust for Gamma
+				color = Vec3(sqrt(color[0]), sqrt(color[1]), sqrt(color[2]));
+
+				int const offset = (y * mWidth + x) * bytesPerPixel;
+				data[offset] = (int8_t)(color.r() * 255.99f);
+				data[offset + 1] = (int8_t)(color.g() * 255.99f);
+				data[offset + 2] = (int8_t)(color.b() * 255.99f);
+			}
+		}
+	}
+
+	bool WritePng(char const* path) const {
+		std::vector<int8_t> data(mWidth * mHeight * 3);
+		ToImage(data.data(), 3);
+		return stbi_write_png(path, mWidth, mHeight, 3, data.data(), mWidth * 3) != 0;
+	}
+
+	// Radiance RGBE, which keeps the range but only 8 bits of precision
+	bool WriteHdr(char const* path) const {
+		std::vector<float> rgb(mWidth * mHeight * 3);
+		for (int y = 0; y < mHeight; ++y) {
+			for (int x = 0; x < mWidth; ++x) {
+				Vec3 const color = Mean(x, y);
+				for (int channel = 0; channel < 3; ++channel) {
+					rgb[(y * mWidth + x) * 3 + channel] = color[channel];
+				}
+			}
+		}
+		return stbi_write_hdr(path, mWidth, mHeight, 3, rgb.data()) != 0;
+	}
+
+	// Portable float map, RGB 32 bit floats, little endian and bottom row first
+	bool WritePfm(char const* path) const {
+		FILE* file = OpenFile(path, "wb");
+		if (!file) {
+			return false;
+		}
+		fprintf(file, "PF\n%d %d\n-1.0\n", mWidth, mHeight);
+		std::vector<uint8_t> row;
+		bool ok = true;
+		for (int y = mHeight - 1; y >= 0 && ok; --y) {
+			row.clear();
+			for (int x = 0; x < mWidth; ++x) {
+				Vec3 const color = Mean(x, y);
+				for (int channel = 0; channel < 3; ++channel) {
+					PutFloat(row, color[channel]);
+				}
+			}
+			ok = fwrite(row.data(), 1, row.size(), file) == row.size();
+		}
+		fclose(file);
+		return ok;
+	}
+
+	// Single part scanline OpenEXR without compression. RGBA, plus samples and variance.R/G/B when the film keeps
+	// them. Sample counts are always 32 bit unsigned
+	bool WriteExr(char const* path, ExrPixelType const pixelType) const {
+		// Channels have to be listed, and stored in each line, in name order
+		struct ExrChannel {
+			char const* mName;
+			int mSource; // Color RGBA 0-3, samples 4, variance RGB 5-7
+		};
+		std::vector<ExrChannel> channels = { { "A", 3 }, { "B", 2 }, { "G", 1 }, { "R", 0 } };
+		if (mChannels & kFilmSampleCount) {
+			channels.push_back({ "samples", 4 });
+		}
+		if (mChannels & kFilmVariance) {
+			channels.push_back({ "variance.B", 7 });
+			channels.push_back({ "variance.G", 6 });
+			channels.push_back({ "variance.R", 5 });
+		}
+		int const valueSize = pixelType == kExrHalf ? 2 : 4;
+
+		std::vector<uint8_t> out;
+		PutInt(out, 20000630); // Magic number
+		PutInt(out, 2); // Version 2, single part scanline
+
+		std::vector<uint8_t> list;
+		for (ExrChannel const& channel : channels) {
+			PutString(list, channel.mName);
+			PutInt(list, channel.mSource == 4 ? 0 : pixelType == kExrHalf ? 1 : 2); // uint, half or float
+			PutInt(list, 0); // Perceptually linear and three reserved bytes
+			PutInt(list, 1); // x and y sampling
+			PutInt(list, 1);
+		}
+		list.push_back(0);
+		PutAttribute(out, "channels", "chlist", list);
+
+		PutAttribute(out, "compression", "compression", std::vector<uint8_t>(1, 0));
+		std::vector<uint8_t> window;
+		PutInt(window, 0);
+		PutInt(window, 0);
+		PutInt(window, mWidth - 1);
+		PutInt(window, mHeight - 1);
+		PutAttribute(out, "dataWindow", "box2i", window);
+		PutAttribute(out, "displayWindow", "box2i", window);
+		PutAttribute(out, "lineOrder", "lineOrder", std::vector<uint8_t>(1, 0)); // Increasing y
+		std::vector<uint8_t> one;
+		PutFloat(one, 1.f);
+		PutAttribute(out, "pixelAspectRatio", "float", one);
+		PutAttribute(out, "screenWindowCenter", "v2f", std::vector<uint8_t>(8, 0));
+		PutAttribute(out, "screenWindowWidth", "float", one);
+		out.push_back(0); // End of the header
+
+		// Offsets of every line from the start of the file, then the lines
+		size_t lineBytes = 0;
+		for (ExrChannel const& channel : channels) {
+			lineBytes += (size_t)mWidth * (channel.mSource == 4 ? 4 : valueSize);
+		}
+		size_t const tableStart = out.size();
+		for (int y = 0; y < mHeight; ++y) {
+			uint64_t const offset = tableStart + (size_t)mHeight * 8 + (size_t)y * (8 + lineBytes);
+			PutInt(out, (uint32_t)offset);
+			PutInt(out, (uint32_t)(offset >> 32));
+		}
+
+		FILE* file = OpenFile(path, "wb");
+		if (!file) {
+			return false;
+		}
+		bool ok = fwrite(out.data(), 1, out.size(), file) == out.size();
+		std::vector<uint8_t> line;
+		for (int y = 0; y < mHeight && ok; ++y) {
+			line.clear();
+			PutInt(line, y);
+			PutInt(line, (uint32_t)lineBytes);
+			for (ExrChannel const& channel : channels) {
+				for (int x = 0; x < mWidth; ++x) {
+					if (channel.mSource == 4) {
+						PutInt(line, (uint32_t)Samples(x, y));
+						continue;
+					}
+					float const value = channel.mSource == 3 ? Alpha(x, y) : channel.mSource < 3 ? Mean(x, y)[channel.mSource] : Variance(x, y)[channel.mSource - 5];
+					if (pixelType == kExrHalf) {
+						uint16_t const half = FloatToHalf(value);
+						line.push_back((uint8_t)half);
+						line.push_back((uint8_t)(half >> 8));
+					}
+					else {
+						PutFloat(line, value);
+					}
+				}
+			}
+			ok = fwrite(line.data(), 1, line.size(), file) == line.size();
+		}
+		fclose(file);
+		return ok;
+	}
+
+	// The format follows path's extension, .exr .hdr and .pfm keep the float values and anything else is a PNG
+	bool Write(char const* path, ExrPixelType const exrPixelType) const {
+		if (HasExtension(path, ".exr")) {
+			return WriteExr(path, exrPixelType);
+		}
+		else if (HasExtension(path, ".hdr")) {
+			return WriteHdr(path);
+		}
+		else if (HasExtension(path, ".pfm")) {
+			return WritePfm(path);
+		}
+		return WritePng(path);
+	}
+
+	int mWidth;
+	int mHeight;
+	int mChannels;
+	std::vector<float> mPixels; // Sums of RGB and the sample count, in four floats a pixel
+	std::vector<float> mSquares; // Sums of squared RGB, only with kFilmVariance
+
+private:
+	static bool HasExtension(char const* path, char const* extension) {
+		size_t const length = strlen(path);
+		size_t const extensionLength = strlen(extension);
+		if (length < extensionLength) {
+			return false;
+		}
+		for (size_t ii = 0; ii < extensionLength; ++ii) {
+			if (tolower((unsigned char)path[length - extensionLength + ii]) != extension[ii]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Little endian whatever the machine is
+	static void PutInt(std::vector<uint8_t>& out, uint32_t const value) {
+		for (int ii = 0; ii < 4; ++ii) {
+			out.push_back((uint8_t)(value >> (ii * 8)));
+		}
+	}
+
+	static void PutFloat(std::vector<uint8_t>& out, float const value) {
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		PutInt(out, bits);
+	}
+
+	static void PutString(std::vector<uint8_t>& out, char const* text) {
+		out.insert(out.end(), text, text + strlen(text) + 1);
+	}
+
+	static void PutAttribute(std::vector<uint8_t>& out, char const* name, char const* type, std::vector<uint8_t> const& value) {
+		PutString(out, name);
+		PutString(out, type);
+		PutInt(out, (uint32_t)value.size());
+		out.insert(out.end(), value.begin(), value.end());
+	}
+};
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "vec3.h"
+#include "util.h"
+
+// What a heatmap render shows for each pixel in place of its color
+enum RenderMode {
+	kRenderColor,
+	kRenderTraversalSteps, // BVH and Octree nodes visited, needs RAY_STATS
+	kRenderPrimitiveTests, // Triangle and sphere tests, needs RAY_STATS
+	kRenderTime, // Nanoseconds
+};
+
+// Names for the integrator setting, the color render is the path tracer and the rest measure what it costs
+char const* const kRenderModeNames[] = { "path", "traversal_steps", "primitive_tests", "time" };
+
+// Black through blue, green and yellow to red as t goes from 0 to 1
+inline Vec3 HeatColor(float const t) {
+	Vec3 const stops[5] = { Vec3(0, 0, 0), Vec3(0, 0, 1), Vec3(0, 1, 0), Vec3(1, 1, 0), Vec3(1, 0, 0) };
+	float const x = fmin(fmax(t, 0.f), 1.f) * 4.f;
+	int const ii = std::min((int)x, 3);
+	float const f = x - (float)ii;
+	return stops[ii] * (1.f - f) + stops[ii + 1] * f;
+}
+
+// Cost of every pixel, written by the render threads with each owning its own pixels
+class Heatmap {
+public:
+	Heatmap(int const width, int const height) : mWidth(width), mHeight(height), mCost(width * height, 0.f) {}
+
+	// y counts up from the bottom like the render loop
+	void Set(int const x, int const y, float const cost) {
+		mCost[((mHeight - 1) - y) * mWidth + x] = cost;
+	}
+
+	// False color scaled to the 99th percentile so a few outliers don't flatten the rest
+	void ToImage(int8_t* data, int const bytesPerPixel) const {
+		std::vector<float> sorted(mCost);
+		std::sort(sorted.begin(), sorted.end());
+		float const scale = sorted.empty() ? 0.f : sorted[(sorted.size() - 1) * 99 / 100];
+
+		for (int ii = 0; ii < mWidth * mHeight; ++ii) {
+			Vec3 const color = HeatColor(scale > 0.f ? mCost[ii] / scale : 0.f);
+			data[ii * bytesPerPixel] = (int8_t)(color.r() * 255.99f);
+			data[ii * bytesPerPixel + 1] = (int8_t)(color.g() * 255.99f);
+			data[ii * bytesPerPixel + 2] = (int8_t)(color.b() * 255.99f);
+		}
+	}
+
+	// Raw 32 bit floats, top row first
+	bool WriteRaw(char const* path) const {
+		FILE* file = OpenFile(path, "wb");
+		if (!file) {
+			return false;
+		}
+		size_t const written = fwrite(mCost.data(), sizeof(float), mCost.size(), file);
+		fclose(file);
+		return written == mCost.size();
+	}
+
+	int mWidth;
+	int mHeight;
+	std::vector<float> mCost;
+};
\ No newline at end of file
@@ -1,27 +1,116 @@
 #pragma once
 
 #include "util.h"
+#include "vec2.h"
+#include "Warp.h"
+
+struct LightSample {
+	Vec3 position;
+	Vec3 normal;
+	Vec3 radiance;
+	float pdf; // With respect to solid angle at the shaded point, 0 if the light can't be seen
+};
 
 class Light : public Object {
 public:
-	virtual Vec3 RandInLight() = 0;
+	Light() : mEmissive(this) {}
+
+	// Pick a point on the light visible from point, u is uniform in [0,1)^2
+	virtual LightSample Sample(Vec3 const& point, Vec2 const& u) const = 0;
+
+	// Density Sample() would pick the unit direction wi from point with
+	virtual float Pdf(Vec3 const& point, Vec3 const& wi) const = 0;
+
+	// Intensity is averaged over all directions, so the emitted radiance is 4 * intensity / area
+	Vec3 Radiance() const {
+		float const radiance = 4.f * mIntensity / mArea;
+		return Vec3(radiance, radiance, radiance);
+	}
+
 	float mIntensity;
+	float mArea;
+	Emissive mEmissive; // Material of the light's own surface
 };
 
 class SphereLight : public Light {
-public: 
+public:
 	SphereLight(Vec3 const& pos, Vec3 const& size, float const intensity) {
 		mIntensity = intensity;
 		mBoundingBox.Expand(pos + size / 2.f);
 		mBoundingBox.Expand(pos - size / 2.f);
-		mSphere = Sphere(pos, size.x() / 2.f, new FlatColor(Vec3(1.f, 1.f, 1.f)));
+		mSphere = Sphere(pos, size.x() / 2.f, &mEmissive);
+		mArea = 4.f * M_PI * mSphere.radius * mSphere.radius;
 	}
 
 	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const {
 		return mSphere.Hit(r, t_min, t_max, rec);
 	}
-	virtual Vec3 RandInLight() {
-		return mBoundingBox.Center() + RandInSphere() * mBoundingBox.GetSize().x(); // Sphere should have all 3 directions the same size
+
+	virtual uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		return mSphere.HitPacket(packet, t_min, rec, mask);
+	}
+
+	// Sample the cone of directions subtended by the sphere so only the visible cap is chosen
+	virtual LightSample Sample(Vec3 const& point, Vec2 const& u) const {
+		LightSample s;
+		s.radiance = Radiance();
+
+		Vec3 const& center = mSphere.center;
+		float const radius = mSphere.radius;
+		Vec3 const toCenter = center - point;
+		float const distSquared = toCenter.lengthSquared();
+
+		// Inside the light, fall back to sampling the whole surface by area
+		if (distSquared <= radius * radius) {
+			s.normal = SquareToUniformSphere(u);
+			s.position = center + radius * s.normal;
+
+			Vec3 const toLight = s.position - point;
+			float const cosLight = fabs(dot(s.normal, toLight.unitVec()));
+			s.pdf = cosLight > 0.f ? toLight.lengthSquared() / (cosLight * mArea) : 0.f;
+			return s;
+		}
+
+		float const dist = sqrt(distSquared);
+		Vec3 const wc = toCenter / dist;
+		Vec3 wcX, wcY;
+		CoordinateSystem(wc, wcX, wcY);
+
+		// Uniform direction inside the cone
+		float const sinThetaMaxSquared = radius * radius / distSquared;
+		float const cosThetaMax = sqrt(fmax(0.f, 1.f - sinThetaMaxSquared));
+		Vec3 const local = SquareToSphericalCap(u, cosThetaMax);
+		Vec3 const dir = local.x() * wcX + local.y() * wcY + local.z() * wc;
+
+		// Find where that direction meets the sphere
+		float const sinThetaSquared = fmax(0.f, 1.f - local.z() * local.z());
+		float const hitDist = dist * local.z() - sqrt(fmax(0.f, radius * radius - distSquared * sinThetaSquared));
+		s.position = point + hitDist * dir;
+		s.normal = (s.position - center).unitVec();
+		s.pdf = SphericalCapPdf(cosThetaMax);
+		return s;
+	}
+
+	virtual float Pdf(Vec3 const& point, Vec3 const& wi) const {
+		float const radius = mSphere.radius;
+		Vec3 const toCenter = mSphere.center - point;
+		float const distSquared = toCenter.lengthSquared();
+
+		// Inside the light, convert the area density of the point wi hits
+		if (distSquared <= radius * radius) {
+			HitRecord rec;
+			if (!mSphere.Hit(Ray(point, wi), 0.f, FLT_MAX, rec)) {
+				return 0.f;
+			}
+			float const cosLight = fabs(dot(rec.normal, wi));
+			return cosLight > 0.f ? rec.t * rec.t / (cosLight * mArea) : 0.f;
+		}
+
+		float const cosThetaMax = sqrt(fmax(0.f, 1.f - radius * radius / distSquared));
+		if (dot(wi, toCenter) < cosThetaMax * sqrt(distSquared)) {
+			return 0.f;
+		}
+		return SphericalCapPdf(cosThetaMax);
 	}
 
 	Sphere mSphere;
@@ -33,17 +122,94 @@ public:
 		mIntensity = intensity;
 		mBoundingBox.Expand(pos + size / 2.f);
 		mBoundingBox.Expand(pos - size / 2.f);
+		mArea = 2.f * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+		mMaterial = &mEmissive;
 	}
 
 	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const {
-		return mBoundingBox.Hit(r);
+		float tNear, tFar;
+		if (!mBoundingBox.Hit(r, tNear, tFar)) {
+			return false;
+		}
+
+		float const t = tNear > t_min ? tNear : tFar;
+		if (t < t_min || t > t_max) {
+			return false;
+		}
+
+		rec.t = t;
+		rec.p = r.point_at_parameter(t);
+		rec.material = mMaterial;
+
+		// The face hit is the axis the point is furthest along relative to the box size
+		Vec3 const local = (rec.p - mBoundingBox.Center()) / mBoundingBox.GetSize();
+		int axis = fabs(local.x()) > fabs(local.y()) ? X_AXIS : Y_AXIS;
+		axis = fabs(local.z()) > fabs(local[axis]) ? Z_AXIS : axis;
+		rec.normal = Vec3(0, 0, 0);
+		rec.normal[axis] = local[axis] > 0.f ? 1.f : -1.f;
+		return true;
 	}
-	virtual Vec3 RandInLight() {
-		return mBoundingBox.mMax - Vec3(RandFloat(), RandFloat(), RandFloat()) * mBoundingBox.GetSize();
+
+	// Sample uniformly by area over the faces that face the point
+	virtual LightSample Sample(Vec3 const& point, Vec2 const& u) const {
+		LightSample s;
+		s.radiance = Radiance();
+
+		Vec3 const size = mBoundingBox.GetSize();
+		float faceArea[3];
+		float faceSide[3];
+		float const visibleArea = VisibleFaces(point, faceArea, faceSide);
+
+		// Inside the light, nothing is visible
+		if (visibleArea <= 0.f) {
+			s.pdf = 0.f;
+			return s;
+		}
+
+		s.position = mBoundingBox.mMin + SquareToBoxSurface(u, size, faceSide, s.normal);
+
+		// Convert from area to solid angle
+		Vec3 const toLight = s.position - point;
+		float const distSquared = toLight.lengthSquared();
+		float const cosLight = fabs(dot(s.normal, toLight)) / sqrt(distSquared);
+		s.pdf = cosLight > 0.f ? distSquared / (cosLight * visibleArea) : 0.f;
+		return s;
 	}
 
-	//Cube mCube;
-};
+	virtual float Pdf(Vec3 const& point, Vec3 const& wi) const {
+		HitRecord rec;
+		if (!Hit(Ray(point, wi), 0.f, FLT_MAX, rec)) {
+			return 0.f;
+		}
+
+		float faceArea[3];
+		float faceSide[3];
+		float const visibleArea = VisibleFaces(point, faceArea, faceSide);
+		float const cosLight = fabs(dot(rec.normal, wi));
+		return visibleArea > 0.f && cosLight > 0.f ? rec.t * rec.t / (cosLight * visibleArea) : 0.f;
+	}
+
+	// Area of the face on each axis that faces the point (0 if neither does) and which side it's on
+	float VisibleFaces(Vec3 const& point, float faceArea[3], float faceSide[3]) const {
+		Vec3 const size = mBoundingBox.GetSize();
+		faceArea[0] = size.y() * size.z();
+		faceArea[1] = size.z() * size.x();
+		faceArea[2] = size.x() * size.y();
+
+		float visibleArea = 0.f;
+		for (int axis = 0; axis < 3; ++axis) {
+			if (point[axis] > mBoundingBox.mMax[axis]) {
+				faceSide[axis] = 1.f;
+			} else if (point[axis] < mBoundingBox.mMin[axis]) {
+				faceSide[axis] = -1.f;
+			} else {
+				faceSide[axis] = 0.f;
+				faceArea[axis] = 0.f;
+			}
+			visibleArea += faceArea[axis];
+		}
+		return visibleArea;
+	}
 
-// Box light
-// Sphere light clas
\ No newline at end of file
+	Material* mMaterial;
+};
\ No newline at end of file
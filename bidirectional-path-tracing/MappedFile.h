@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped into memory. Pages are copy on write, so the contents can be changed in place without
+// touching the file, and only the pages that are changed get copied
+class MappedFile {
+public:
+	MappedFile() : mData(nullptr), mSize(0) {
+#if defined(_WIN32)
+		mMapping = nullptr;
+#endif
+	}
+
+	~MappedFile() {
+		Close();
+	}
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	// False if the file can't be opened. An empty file opens with no data
+	bool Open(char const* path) {
+		Close();
+#if defined(_WIN32)
+		HANDLE const file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size)) {
+			CloseHandle(file);
+			return false;
+		}
+		if (size.QuadPart > 0) {
+			mMapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			mData = mMapping ? (char*)MapViewOfFile(mMapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+		}
+		CloseHandle(file);
+		if (size.QuadPart > 0 && !mData) {
+			Close();
+			return false;
+		}
+		mSize = (size_t)size.QuadPart;
+#else
+		int const fd = open(path, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0) {
+			close(fd);
+			return false;
+		}
+		if (info.st_size > 0) {
+			void* const data = mmap(nullptr, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED) {
+				close(fd);
+				return false;
+			}
+			mData = (char*)data;
+		}
+		close(fd);
+		mSize = (size_t)info.st_size;
+#endif
+		return true;
+	}
+
+	void Close() {
+#if defined(_WIN32)
+		if (mData) {
+			UnmapViewOfFile(mData);
+		}
+		if (mMapping) {
+			CloseHandle(mMapping);
+		}
+		mMapping = nullptr;
+#else
+		if (mData) {
+			munmap(mData, mSize);
+		}
+#endif
+		mData = nullptr;
+		mSize = 0;
+	}
+
+	char* Data() const { return mData; }
+	size_t Size() const { return mSize; }
+
+private:
+	char* mData;
+	size_t mSize;
+#if defined(_WIN32)
+	HANDLE mMapping;
+#endif
+};
+
+// Size and last write time of a file, which change whenever it's written. Telling those apart doesn't need the
+// file read
+struct FileStamp {
+	uint64_t mSize;
+	int64_t mModified; // In the platform's own units, only ever compared
+};
+
+inline bool operator==(FileStamp const& a, FileStamp const& b) {
+	return a.mSize == b.mSize && a.mModified == b.mModified;
+}
+
+// False if there's no file at path
+inline bool ReadFileStamp(char const* path, FileStamp& stamp) {
+#if defined(_WIN32)
+	WIN32_FILE_ATTRIBUTE_DATA info;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) {
+		return false;
+	}
+	stamp.mSize = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+	stamp.mModified = (int64_t)(((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime);
+#else
+	struct stat info;
+	if (stat(path, &info) != 0) {
+		return false;
+	}
+	stamp.mSize = (uint64_t)info.st_size;
+#if defined(__APPLE__)
+	stamp.mModified = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+	stamp.mModified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+	return true;
+}
\ No newline at end of file
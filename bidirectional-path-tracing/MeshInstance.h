@@ -0,0 +1,52 @@
+#pragma once
+
+#include "mesh.h"
+
+// A placement of a shared mesh, which is never changed itself. Rays are moved into the mesh's space instead of
+// moving its vertices and BVH, so any number of instances cost one mesh
+class MeshInstance : public Object {
+public:
+	// material replaces the mesh's own when it isn't nullptr
+	MeshInstance(Mesh const* mesh, Vec3 const& translation, Material* material) : mMesh(mesh), mTranslation(translation),
+		mMaterial(material ? material : mesh->material) {
+		mBoundingBox = mesh->mBoundingBox;
+		mBoundingBox.Translate(translation);
+	}
+
+	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const {
+		Ray local = r;
+		local.A = r.origin() - mTranslation;
+		local.originInvDir = local.A * local.invDir;
+		if (!mMesh->mAccelerationStructure->Hit(local, t_min, t_max, rec)) {
+			return false;
+		}
+		rec.p += mTranslation;
+		rec.material = mMaterial;
+		return true;
+	}
+
+	virtual uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		RayPacket local = packet;
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			local.mOriginX[ii] -= mTranslation.x();
+			local.mOriginY[ii] -= mTranslation.y();
+			local.mOriginZ[ii] -= mTranslation.z();
+			local.mOriginInvDirX[ii] = local.mOriginX[ii] * local.mInvDirX[ii];
+			local.mOriginInvDirY[ii] = local.mOriginY[ii] * local.mInvDirY[ii];
+			local.mOriginInvDirZ[ii] = local.mOriginZ[ii] * local.mInvDirZ[ii];
+		}
+
+		uint32_t const hit = mMesh->mAccelerationStructure->HitPacket(local, t_min, rec, mask);
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			if (hit & (1u << ii)) {
+				rec.rec[ii].p += mTranslation;
+				rec.rec[ii].material = mMaterial;
+			}
+		}
+		return hit;
+	}
+
+	Mesh const* mMesh;
+	Vec3 mTranslation;
+	Material* mMaterial;
+};
\ No newline at end of file
@@ -2,39 +2,50 @@
 
 #include <string>
 #include "mesh.h"
+#include "MeshInstance.h"
 #include <fstream>
 
+#if !defined(NO_ASSIMP)
 #include "assimp/scene.h"
+#endif
 
 
 class Model
 {
 public:
-	Model(aiScene const* mObject) {
+#if !defined(NO_ASSIMP)
+	// The meshes' BVHs aren't built yet
+	Model(aiScene const* mObject, Arena& arena) {
 		mMeshCount = mObject->mNumMeshes;
-		mMeshes = new Mesh*[mMeshCount];
+		mMeshes = arena.NewArray<Mesh*>(mMeshCount);
 
 		// Initialize scene meshes one by one
 		for (uint32_t ii = 0; ii < mMeshCount; ++ii) {
 			aiMesh const* tempMesh = mObject->mMeshes[ii];
-			Mesh* newMesh = new Mesh(tempMesh, mObject->mMaterials[tempMesh->mMaterialIndex]);
+			Mesh* newMesh = arena.New<Mesh>(tempMesh, mObject->mMaterials[tempMesh->mMaterialIndex], arena);
 			mMeshes[ii] = newMesh;
 		}
 	}
+#endif
 
-	void AddMeshes(std::vector<Object*>& objectList, Vec3 const& trans, Material* materialOverride = nullptr) {
-		for (int ii = 0; ii < mMeshCount; ++ii) {
-			// Translate
-			// TODO: Rotate, Scale
-			mMeshes[ii]->Translate(trans);
+	// Meshes that are already built, like ones from a scene cache
+	Model(Mesh** meshes, uint32_t const meshCount) : mMeshes(meshes), mMeshCount(meshCount) {}
 
-			// Replace material
-			if (materialOverride) {
-				mMeshes[ii]->material = materialOverride;
+	// An instance of every mesh placed at trans, the meshes themselves are left as they are so the model can be
+	// added any number of times. Instances go in arena. Meshes the file doesn't give a material, and that
+	// materialOverride doesn't cover, are plain grey so there's always something to shade
+	void AddMeshes(std::vector<Object*>& objectList, Vec3 const& trans, Arena& arena, Material* materialOverride = nullptr) const {
+		Material* fallback = nullptr;
+		for (uint32_t ii = 0; ii < mMeshCount; ++ii) {
+			Material* material = materialOverride;
+			if (!material && !mMeshes[ii]->material) {
+				if (!fallback) {
+					fallback = arena.New<Solid>(Vec3(0.6f, 0.6f, 0.6f), Vec3(0.f, 0.f, 0.f), 0.f);
+				}
+				material = fallback;
 			}
-
-			// Add mesh to list
-			objectList.push_back(mMeshes[ii]);
+			// TODO: Rotate, Scale
+			objectList.push_back(arena.New<MeshInstance>(mMeshes[ii], trans, material));
 		}
 	}
 
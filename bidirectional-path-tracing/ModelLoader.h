@@ -1,33 +1,231 @@
 #pragma once
 #include "Model.h"
 #include "object.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "SceneCache.h"
+#include "ThreadPool.h"
+#include "PerfCounters.h"
+#include "Trace.h"
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+// Define NO_ASSIMP to build without assimp, then only OBJ files can be loaded
+#if !defined(NO_ASSIMP)
 #include "assimp/Importer.hpp"
 #include "assimp/postprocess.h"
 #include "assimp/scene.h"
 
+unsigned int const kImportFlags = aiProcessPreset_TargetRealtime_MaxQuality;
+#endif
+
+// Keys scene caches of models from ObjLoader, which doesn't use any assimp flags
+unsigned int const kNativeObjImportFlags = 0;
+
+// A model loading on a ThreadPool. mModel is set once mReady has run, which is after its import and every mesh's
+// BVH build, and stays nullptr if the file couldn't be loaded. mDone runs after that and after the scene cache is
+// written, when nothing uses the loader's arena any more
+struct PendingModel {
+	Model const* mModel;
+	Job* mReady;
+	Job* mDone;
+};
 
 class ModelLoader {
 
 public:
-	Model* LoadModel(std::string const& filename) {
+	// Models are placed in arena and kept for as long as it is. useCache loads models from a scene cache next to
+	// them when it matches, and writes one when it doesn't. nativeObj reads OBJ files with ObjLoader instead of assimp.
+	// pool is only needed for LoadModelAsync
+	ModelLoader(Arena& arena, bool const useCache = true, bool const nativeObj = true, ThreadPool* pool = nullptr)
+		: mArena(arena), mUseCache(useCache), mNativeObj(nativeObj), mPool(pool) {}
 
-		Assimp::Importer importer;
+	// Each file is only loaded once, later calls give the same model. Models are shared, so place them with
+	// Model::AddMeshes rather than changing them. Not from inside a job, it may wait for one
+	Model const* LoadModel(std::string const& filename) {
+		auto const loaded = mModels.find(filename);
+		if (loaded != mModels.end()) {
+			if (loaded->second.mReady) {
+				mPool->Wait(loaded->second.mReady);
+			}
+			return loaded->second.mModel;
+		}
+
+		ImportedModel const imported = Import(filename);
+		if (imported.mModel && !imported.mFromCache) {
+			for (uint32_t ii = 0; ii < imported.mModel->mMeshCount; ++ii) {
+				imported.mModel->mMeshes[ii]->BuildAccelerationStructure(mArena);
+			}
+			WriteCache(filename, imported);
+		}
+		if (imported.mModel) {
+			PendingModel& model = mModels[filename];
+			model.mModel = imported.mModel;
+			model.mReady = nullptr;
+			model.mDone = nullptr;
+		}
+		return imported.mModel;
+	}
+
+	// Start loading filename on the pool and return straight away. The import is a job that hands OBJ files on to
+	// LoadObjAsync's jobs, each mesh's BVH is built by a job of its own once they're done, and the scene cache is
+	// written after them without holding up mReady. The loader has to outlive the jobs
+	PendingModel const* LoadModelAsync(std::string const& filename) {
+		auto const loaded = mModels.find(filename);
+		if (loaded != mModels.end()) {
+			return &loaded->second;
+		}
 
-		// Check if the file exists
-		std::ifstream infile(filename);
-		if (!infile.fail()) {
-			infile.close();
+		// Elements of an unordered_map stay where they are, so the jobs can hold on to it
+		PendingModel* pending = &mModels[filename];
+		pending->mModel = nullptr;
+		pending->mReady = mPool->Prepare([]() {});
+		pending->mDone = mPool->Prepare([]() {}, { pending->mReady });
+		Job* import = mPool->Add([this, pending, filename]() {
+			std::shared_ptr<ImportedModel> imported(new ImportedModel());
+			std::shared_ptr<std::vector<std::string>> libraries(new std::vector<std::string>());
+			bool native = false;
+			if (!BeginImport(filename, *imported, native)) {
+				pending->mModel = imported->mModel;
+				return;
+			}
+
+			// OBJ files are parsed by jobs of their own on the same pool
+			Job* loaded = nullptr;
+			if (native) {
+				loaded = LoadObjAsync(*mPool, filename, mArena, &imported->mModel, libraries.get());
+			}
+			else {
+				imported->mModel = LoadWithAssimp(filename, mArena);
+			}
+
+			Job* build = mPool->Add([this, pending, filename, imported, libraries]() {
+				FinishImport(*imported, *libraries);
+				pending->mModel = imported->mModel;
+				if (!imported->mModel) {
+					return;
+				}
+
+				Arena* arena = &mArena;
+				std::vector<Job*> builds;
+				for (uint32_t ii = 0; ii < imported->mModel->mMeshCount; ++ii) {
+					Mesh* mesh = imported->mModel->mMeshes[ii];
+					builds.push_back(mPool->Add([mesh, arena]() { mesh->BuildAccelerationStructure(*arena); }));
+					mPool->AddDependency(pending->mReady, builds.back());
+				}
+				Job* write = mPool->Add([this, filename, imported]() { WriteCache(filename, *imported); }, builds);
+				mPool->AddDependency(pending->mDone, write);
+			}, { loaded });
+			mPool->AddDependency(pending->mReady, build);
+		});
+		mPool->AddDependency(pending->mReady, import);
+		mPool->Submit(pending->mReady);
+		mPool->Submit(pending->mDone);
+		return pending;
+	}
+
+private:
+	// What a model was imported from, for writing its scene cache once its BVHs are built
+	struct ImportedModel {
+		Model* mModel;
+		bool mFromCache;
+		std::vector<SceneCacheSource> mSources; // The model, then the material libraries it read
+		unsigned int mImportFlags;
+	};
+
+	// The model in filename, from its scene cache if there's one that matches. Meshes that didn't come from the
+	// cache still need their BVHs built. Not from inside a job, OBJ files are parsed on the pool when there is one
+	ImportedModel Import(std::string const& filename) {
+		ImportedModel imported;
+		bool native = false;
+		if (BeginImport(filename, imported, native)) {
+			std::vector<std::string> libraries;
+			imported.mModel = native ? LoadObj(filename, mArena, &libraries, mPool) : LoadWithAssimp(filename, mArena);
+			FinishImport(imported, libraries);
 		}
-		else {
+		return imported;
+	}
+
+	// Loads filename from its scene cache if there's one that matches. False when there's nothing left to import,
+	// because it came from the cache or can't be loaded. Otherwise native says whether ObjLoader reads it
+	bool BeginImport(std::string const& filename, ImportedModel& imported, bool& native) {
+		TRACE_SCOPE("LoadModel");
+		PERF_PHASE(kPerfLoad);
+
+		imported.mModel = nullptr;
+		imported.mFromCache = false;
+
+		// Check if the file exists, the cache is keyed on it
+		imported.mSources.resize(1);
+		SceneCacheSource& source = imported.mSources[0];
+		if (!OpenSceneCacheSource(filename, source)) {
 			printf("Couldn't open file: %s\n", filename.c_str());
-			printf("%s\n", importer.GetErrorString());
-			return nullptr;
+			return false;
+		}
+
+		std::string extension = filename.substr(filename.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+#if defined(NO_ASSIMP)
+		if (extension != "obj") {
+			printf("Only OBJ files can be loaded without assimp: %s\n", filename.c_str());
+			return false;
+		}
+		native = true;
+		imported.mImportFlags = kNativeObjImportFlags;
+#else
+		native = mNativeObj && extension == "obj";
+		imported.mImportFlags = native ? kNativeObjImportFlags : kImportFlags;
+#endif
+
+		if (mUseCache) {
+			imported.mModel = LoadSceneCache(filename + kSceneCacheExtension, source, imported.mImportFlags, mArena);
+			if (imported.mModel) {
+				imported.mFromCache = true;
+				return false;
+			}
+
+			// Before importing, so the cache that's written describes the contents that were read
+			if (!HashSceneCacheSource(source)) {
+				printf("Couldn't open file: %s\n", filename.c_str());
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Materials come from these as well, ones that couldn't be read are recorded as missing
+	void FinishImport(ImportedModel& imported, std::vector<std::string> const& libraries) {
+		for (size_t ii = 0; mUseCache && ii < libraries.size(); ++ii) {
+			SceneCacheSource dependency;
+			if (OpenSceneCacheSource(libraries[ii], dependency)) {
+				HashSceneCacheSource(dependency);
+			}
+			imported.mSources.push_back(dependency);
 		}
+	}
+
+	void WriteCache(std::string const& filename, ImportedModel const& imported) {
+		std::string const cachePath = filename + kSceneCacheExtension;
+		if (mUseCache && !WriteSceneCache(cachePath, imported.mSources, imported.mImportFlags, *imported.mModel)) {
+			printf("Couldn't write scene cache: %s\n", cachePath.c_str());
+		}
+	}
+
+#if defined(NO_ASSIMP)
+	Model* LoadWithAssimp(std::string const&, Arena&) {
+		return nullptr;
+	}
+#else
+	Model* LoadWithAssimp(std::string const& filename, Arena& arena) {
+		Assimp::Importer importer;
 
-		aiScene const* mScene = importer.ReadFile(filename, aiProcessPreset_TargetRealtime_MaxQuality);
+		aiScene const* mScene;
+		{
+			TRACE_SCOPE("assimp ReadFile");
+			mScene = importer.ReadFile(filename, kImportFlags);
+		}
 		// TODO: Use ASSIMP to translate/scale models
 
 		// Check if import failed
@@ -36,8 +234,14 @@ public:
 			printf("%s\n", importer.GetErrorString());
 			return nullptr;
 		}
-			
-		return new Model(mScene);
+
+		return arena.New<Model>(mScene, arena);
 	}
+#endif
 
+	Arena& mArena;
+	bool mUseCache;
+	bool mNativeObj;
+	ThreadPool* mPool;
+	std::unordered_map<std::string, PendingModel> mModels; // By path as it was given
 };
\ No newline at end of file
@@ -0,0 +1,618 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Arena.h"
+#include "MappedFile.h"
+#include "Model.h"
+#include "PerfCounters.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+
+// Wavefront OBJ and MTL without assimp. The file is mapped, split at line breaks into one chunk per pool thread
+// and the chunks are parsed by jobs in parallel. Faces are fan triangulated, split into one mesh per material
+// and each mesh's corners are deduplicated into indexed vertex buffers
+
+// Below this a chunk isn't worth a job
+size_t const kObjMinChunkSize = 256 << 10;
+
+double const kPowersOfTen[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+inline char const* SkipObjSpaces(char const* p, char const* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+		++p;
+	}
+	return p;
+}
+
+inline char const* SkipObjLine(char const* p, char const* end) {
+	char const* const newline = (char const*)memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+// Decimal number with optional sign, fraction and exponent. The first 19 digits are kept as an integer and scaled
+// once, so results are within an ulp or two of strtof, which is plenty for geometry
+float ParseObjFloat(char const*& p, char const* end) {
+	p = SkipObjSpaces(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	uint64_t mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa > 0;
+		} else {
+			++exponent;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa > 0;
+				--exponent;
+			}
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = *p == '-';
+			++p;
+		}
+		int value = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+			value = std::min(value * 10 + (*p - '0'), 10000);
+		}
+		exponent += negativeExponent ? -value : value;
+	}
+
+	double result = (double)mantissa;
+	if (exponent >= -22 && exponent <= 22) {
+		result = exponent < 0 ? result / kPowersOfTen[-exponent] : result * kPowersOfTen[exponent];
+	} else {
+		result *= pow(10.0, exponent);
+	}
+	return (float)(negative ? -result : result);
+}
+
+// 1 based or negative from the end, 0 if there isn't one. Indices past what int32 holds saturate, so they fail
+// the merge's range check instead of wrapping onto a real vertex
+inline int32_t ParseObjIndex(char const*& p, char const* end) {
+	bool negative = false;
+	if (p < end && *p == '-') {
+		negative = true;
+		++p;
+	}
+	int64_t value = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+		value = std::min(value * 10 + (*p - '0'), (int64_t)INT32_MAX + 1);
+	}
+	return negative ? (int32_t)-value : (int32_t)std::min(value, (int64_t)INT32_MAX);
+}
+
+// Whether the line at p starts with keyword followed by a space
+inline bool ObjKeyword(char const* p, char const* end, char const* keyword, size_t const length) {
+	return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+}
+
+inline std::string ParseObjName(char const* p, char const* end) {
+	p = SkipObjSpaces(p, end);
+	char const* nameEnd = p;
+	while (nameEnd < end && *nameEnd != '\n' && *nameEnd != '\r' && *nameEnd != '#') {
+		++nameEnd;
+	}
+	while (nameEnd > p && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) {
+		--nameEnd;
+	}
+	return std::string(p, nameEnd);
+}
+
+enum ObjAttribute {
+	kObjPosition,
+	kObjTexCoord,
+	kObjNormal,
+	kObjAttributeCount,
+};
+
+// Zero based into the whole file's arrays, -1 when a corner doesn't have one
+struct ObjCorner {
+	int32_t mIndices[kObjAttributeCount];
+};
+
+// Faces from mFirstTriangle on use material mName
+struct ObjMaterialRun {
+	std::string mName;
+	uint32_t mFirstTriangle;
+};
+
+// Everything in one chunk of the file. Negative indices count back from this chunk's own vertices until the
+// merge knows how many came before
+struct ObjChunk {
+	std::vector<float> mPositions;
+	std::vector<float> mTexCoords;
+	std::vector<float> mNormals;
+	std::vector<ObjCorner> mCorners; // Three per triangle
+	std::vector<ObjMaterialRun> mRuns;
+	std::vector<uint32_t> mRelative; // Corner * kObjAttributeCount + attribute for each negative index
+	std::vector<std::string> mLibraries;
+};
+
+void ParseObjChunk(char const* p, char const* end, ObjChunk& chunk) {
+	std::vector<ObjCorner> polygon;
+	while (p < end) {
+		p = SkipObjSpaces(p, end);
+		if (ObjKeyword(p, end, "v", 1)) {
+			p += 1;
+			for (int axis = 0; axis < 3; ++axis) {
+				chunk.mPositions.push_back(ParseObjFloat(p, end));
+			}
+		} else if (ObjKeyword(p, end, "vn", 2)) {
+			p += 2;
+			for (int axis = 0; axis < 3; ++axis) {
+				chunk.mNormals.push_back(ParseObjFloat(p, end));
+			}
+		} else if (ObjKeyword(p, end, "vt", 2)) {
+			p += 2;
+			chunk.mTexCoords.push_back(ParseObjFloat(p, end));
+			chunk.mTexCoords.push_back(ParseObjFloat(p, end));
+		} else if (ObjKeyword(p, end, "f", 1)) {
+			p += 1;
+			int32_t const counts[kObjAttributeCount] = { (int32_t)(chunk.mPositions.size() / 3), (int32_t)(chunk.mTexCoords.size() / 2), (int32_t)(chunk.mNormals.size() / 3) };
+			std::vector<uint32_t> relative;
+			polygon.clear();
+			for (p = SkipObjSpaces(p, end); p < end && *p != '\n' && *p != '#'; p = SkipObjSpaces(p, end)) {
+				// v, v/vt, v//vn or v/vt/vn
+				ObjCorner corner;
+				for (int attribute = 0; attribute < kObjAttributeCount; ++attribute) {
+					int32_t const index = ParseObjIndex(p, end);
+					if (index < 0) {
+						relative.push_back((uint32_t)(polygon.size() * kObjAttributeCount + attribute));
+						corner.mIndices[attribute] = counts[attribute] + index;
+					} else {
+						corner.mIndices[attribute] = index - 1;
+					}
+					if (attribute + 1 < kObjAttributeCount) {
+						if (p < end && *p == '/') {
+							++p;
+						} else {
+							corner.mIndices[attribute + 1] = -1;
+							corner.mIndices[kObjNormal] = -1;
+							break;
+						}
+					}
+				}
+				polygon.push_back(corner);
+				// Skip anything that wasn't a number, so bad input can't stall the loop
+				while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+					++p;
+				}
+			}
+
+			// Fan, with the relative indices of each corner carried over to where it lands
+			for (size_t ii = 1; ii + 1 < polygon.size(); ++ii) {
+				size_t const corners[3] = { 0, ii, ii + 1 };
+				for (size_t const corner : corners) {
+					for (uint32_t const slot : relative) {
+						if (slot / kObjAttributeCount == corner) {
+							chunk.mRelative.push_back((uint32_t)chunk.mCorners.size() * kObjAttributeCount + slot % kObjAttributeCount);
+						}
+					}
+					chunk.mCorners.push_back(polygon[corner]);
+				}
+			}
+		} else if (ObjKeyword(p, end, "usemtl", 6)) {
+			ObjMaterialRun run;
+			run.mName = ParseObjName(p + 6, end);
+			run.mFirstTriangle = (uint32_t)(chunk.mCorners.size() / 3);
+			chunk.mRuns.push_back(run);
+		} else if (ObjKeyword(p, end, "mtllib", 6)) {
+			chunk.mLibraries.push_back(ParseObjName(p + 6, end));
+		}
+		p = SkipObjLine(p, end);
+	}
+}
+
+// Kd, Ks and Ns of every material in an MTL file, added to names and materials
+void LoadMtl(std::string const& path, std::vector<std::string>& names, std::vector<MeshMaterial>& materials) {
+	MappedFile file;
+	if (!file.Open(path.c_str())) {
+		printf("Couldn't open material library: %s\n", path.c_str());
+		return;
+	}
+	char const* p = file.Data();
+	char const* const end = p + file.Size();
+	MeshMaterial* material = nullptr;
+	while (p < end) {
+		p = SkipObjSpaces(p, end);
+		if (ObjKeyword(p, end, "newmtl", 6)) {
+			names.push_back(ParseObjName(p + 6, end));
+			materials.push_back(MeshMaterial());
+			material = &materials.back();
+			material->mPresent = 1;
+		} else if (material && ObjKeyword(p, end, "Kd", 2)) {
+			p += 2;
+			for (int channel = 0; channel < 3; ++channel) {
+				material->mDiffuse[channel] = ParseObjFloat(p, end);
+			}
+		} else if (material && ObjKeyword(p, end, "Ks", 2)) {
+			p += 2;
+			for (int channel = 0; channel < 3; ++channel) {
+				material->mSpecular[channel] = ParseObjFloat(p, end);
+			}
+		} else if (material && ObjKeyword(p, end, "Ns", 2)) {
+			p += 2;
+			material->mShininess = ParseObjFloat(p, end);
+		}
+		p = SkipObjLine(p, end);
+	}
+}
+
+// From a corner's indices to the vertex made for it. Vertices are chained per position, and faces mostly use
+// positions near each other, so lookups stay in cache. Positions spread much wider than the mesh has corners
+// use open addressing instead, so memory stays in proportion to the mesh
+class ObjVertexMap {
+public:
+	ObjVertexMap(int32_t const firstPosition, int32_t const lastPosition, size_t const corners) : mFirstPosition(firstPosition), mShift(60) {
+		size_t const range = (size_t)(lastPosition - firstPosition) + 1;
+		mChained = range <= 4 * corners + 1024;
+		if (mChained) {
+			mHeads.assign(range, UINT32_MAX);
+			return;
+		}
+		size_t capacity = 16;
+		while (capacity < corners * 2) {
+			capacity *= 2;
+			--mShift;
+		}
+		mKeys.resize(capacity);
+		mValues.assign(capacity, UINT32_MAX);
+		mMask = capacity - 1;
+	}
+
+	// The vertex for corner, or UINT32_MAX after adding next for it. next must count up from 0
+	uint32_t FindOrAdd(ObjCorner const& corner, uint32_t const next) {
+		if (mChained) {
+			uint32_t& head = mHeads[corner.mIndices[kObjPosition] - mFirstPosition];
+			for (uint32_t vertex = head; vertex != UINT32_MAX; vertex = mNext[vertex]) {
+				if (Equal(mKeys[vertex], corner)) {
+					return vertex;
+				}
+			}
+			mKeys.push_back(corner);
+			mNext.push_back(head);
+			head = next;
+			return UINT32_MAX;
+		}
+
+		uint64_t hash = (uint64_t)(uint32_t)corner.mIndices[kObjPosition];
+		hash = (hash ^ ((uint64_t)(uint32_t)corner.mIndices[kObjTexCoord] << 32)) * 0x9E3779B97F4A7C15ull;
+		hash = (hash ^ (uint32_t)corner.mIndices[kObjNormal]) * 0xC2B2AE3D27D4EB4Full;
+		// The top bits are the best mixed
+		for (size_t slot = (size_t)(hash >> mShift);; slot = (slot + 1) & mMask) {
+			if (mValues[slot] == UINT32_MAX) {
+				mKeys[slot] = corner;
+				mValues[slot] = next;
+				return UINT32_MAX;
+			}
+			if (Equal(mKeys[slot], corner)) {
+				return mValues[slot];
+			}
+		}
+	}
+
+private:
+	static bool Equal(ObjCorner const& a, ObjCorner const& b) {
+		return a.mIndices[0] == b.mIndices[0] && a.mIndices[1] == b.mIndices[1] && a.mIndices[2] == b.mIndices[2];
+	}
+
+	int32_t mFirstPosition;
+	bool mChained;
+	std::vector<uint32_t> mHeads; // Last vertex made for each position
+	std::vector<uint32_t> mNext; // Vertex made before this one for the same position
+	std::vector<ObjCorner> mKeys; // By vertex when chained, by slot otherwise
+	std::vector<uint32_t> mValues;
+	size_t mMask;
+	int mShift;
+};
+
+// Corners [mFirst, mEnd) of a chunk
+struct ObjRange {
+	ObjCorner const* mFirst;
+	ObjCorner const* mEnd;
+};
+
+// The corners of every triangle that uses one material, turned into buffers
+struct ObjMesh {
+	std::vector<ObjRange> mRanges;
+	std::vector<float> mAttributes[kVertexAttributeCount];
+	std::vector<uint32_t> mIndices;
+	MeshMaterial mMaterial;
+};
+
+// Normals are smoothed over the faces around each vertex when the file doesn't have them
+void BuildObjMesh(ObjMesh& mesh, std::vector<float> const& positions, std::vector<float> const& texCoords, std::vector<float> const& normals) {
+	size_t cornerCount = 0;
+	int32_t firstPosition = INT32_MAX;
+	int32_t lastPosition = 0;
+	for (ObjRange const& range : mesh.mRanges) {
+		cornerCount += range.mEnd - range.mFirst;
+		for (ObjCorner const* corner = range.mFirst; corner < range.mEnd; ++corner) {
+			firstPosition = std::min(firstPosition, corner->mIndices[kObjPosition]);
+			lastPosition = std::max(lastPosition, corner->mIndices[kObjPosition]);
+		}
+	}
+	if (cornerCount == 0) {
+		return;
+	}
+	ObjVertexMap map(firstPosition, lastPosition, cornerCount);
+	mesh.mIndices.reserve(cornerCount);
+	for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+		mesh.mAttributes[attribute].reserve(cornerCount / 4);
+	}
+	bool smooth = false;
+	for (ObjRange const& range : mesh.mRanges) {
+		for (ObjCorner const* corner = range.mFirst; corner < range.mEnd; ++corner) {
+			uint32_t const next = (uint32_t)mesh.mAttributes[kPosX].size();
+			uint32_t const found = map.FindOrAdd(*corner, next);
+			if (found != UINT32_MAX) {
+				mesh.mIndices.push_back(found);
+				continue;
+			}
+			mesh.mIndices.push_back(next);
+
+			int32_t const position = corner->mIndices[kObjPosition];
+			int32_t const texCoord = corner->mIndices[kObjTexCoord];
+			int32_t const normal = corner->mIndices[kObjNormal];
+			for (int axis = 0; axis < 3; ++axis) {
+				mesh.mAttributes[kPosX + axis].push_back(positions[3 * (size_t)position + axis]);
+				mesh.mAttributes[kNormX + axis].push_back(normal >= 0 ? normals[3 * (size_t)normal + axis] : 0.f);
+			}
+			mesh.mAttributes[kTexU].push_back(texCoord >= 0 ? texCoords[2 * (size_t)texCoord] : 0.f);
+			mesh.mAttributes[kTexV].push_back(texCoord >= 0 ? texCoords[2 * (size_t)texCoord + 1] : 0.f);
+			smooth |= normal < 0;
+		}
+	}
+	mesh.mRanges.clear();
+
+	if (!smooth) {
+		return;
+	}
+	std::vector<Vec3> sums(mesh.mAttributes[kPosX].size(), Vec3(0, 0, 0));
+	auto position = [&](uint32_t const vertex) {
+		return Vec3(mesh.mAttributes[kPosX][vertex], mesh.mAttributes[kPosY][vertex], mesh.mAttributes[kPosZ][vertex]);
+	};
+	for (size_t ii = 0; ii + 2 < mesh.mIndices.size(); ii += 3) {
+		uint32_t const* face = &mesh.mIndices[ii];
+		Vec3 const a = position(face[0]);
+		Vec3 const faceNormal = cross(position(face[1]) - a, position(face[2]) - a); // Area weighted
+		for (int corner = 0; corner < 3; ++corner) {
+			sums[face[corner]] += faceNormal;
+		}
+	}
+	for (size_t ii = 0; ii < sums.size(); ++ii) {
+		if (mesh.mAttributes[kNormX][ii] == 0.f && mesh.mAttributes[kNormY][ii] == 0.f && mesh.mAttributes[kNormZ][ii] == 0.f && sums[ii].length() > 0.f) {
+			Vec3 const n = normalize(sums[ii]);
+			mesh.mAttributes[kNormX][ii] = n.x();
+			mesh.mAttributes[kNormY][ii] = n.y();
+			mesh.mAttributes[kNormZ][ii] = n.z();
+		}
+	}
+}
+
+// What the jobs of one LoadObjAsync share, freed with the last of them
+struct ObjLoad {
+	std::string mPath;
+	Arena* mArena;
+	Model** mModel;
+	std::vector<std::string>* mLibraries;
+	MappedFile mFile;
+	std::vector<ObjChunk> mChunks;
+	std::vector<float> mPositions;
+	std::vector<float> mTexCoords;
+	std::vector<float> mNormals;
+	std::vector<ObjMesh> mMeshes;
+	bool mValid; // Cleared by the merge when the file can't be used
+};
+
+// Join the chunks' vertex data, resolve negative indices, check every index is in range, read the materials and
+// split the triangles into meshes. False if an index is out of range
+bool MergeObjChunks(ObjLoad& load) {
+	std::vector<ObjChunk>& chunks = load.mChunks;
+	std::vector<float>* const arrays[kObjAttributeCount] = { &load.mPositions, &load.mTexCoords, &load.mNormals };
+	size_t const widths[kObjAttributeCount] = { 3, 2, 3 };
+	for (ObjChunk& chunk : chunks) {
+		std::vector<float> const* const chunkArrays[kObjAttributeCount] = { &chunk.mPositions, &chunk.mTexCoords, &chunk.mNormals };
+		int32_t bases[kObjAttributeCount];
+		for (int attribute = 0; attribute < kObjAttributeCount; ++attribute) {
+			bases[attribute] = (int32_t)(arrays[attribute]->size() / widths[attribute]);
+			arrays[attribute]->insert(arrays[attribute]->end(), chunkArrays[attribute]->begin(), chunkArrays[attribute]->end());
+		}
+		for (uint32_t const slot : chunk.mRelative) {
+			chunk.mCorners[slot / kObjAttributeCount].mIndices[slot % kObjAttributeCount] += bases[slot % kObjAttributeCount];
+		}
+		chunk.mPositions = std::vector<float>();
+		chunk.mTexCoords = std::vector<float>();
+		chunk.mNormals = std::vector<float>();
+	}
+	if (load.mPositions.size() / 3 >= (size_t)INT32_MAX || load.mTexCoords.size() / 2 >= (size_t)INT32_MAX || load.mNormals.size() / 3 >= (size_t)INT32_MAX) {
+		printf("Too many vertices in %s\n", load.mPath.c_str());
+		return false;
+	}
+	int32_t const counts[kObjAttributeCount] = { (int32_t)(load.mPositions.size() / 3), (int32_t)(load.mTexCoords.size() / 2), (int32_t)(load.mNormals.size() / 3) };
+	for (ObjChunk const& chunk : chunks) {
+		for (ObjCorner const& corner : chunk.mCorners) {
+			for (int attribute = 0; attribute < kObjAttributeCount; ++attribute) {
+				int32_t const index = corner.mIndices[attribute];
+				if (index >= counts[attribute] || (index < 0 && (attribute == kObjPosition || index != -1))) {
+					printf("Face index out of range in %s\n", load.mPath.c_str());
+					return false;
+				}
+			}
+		}
+	}
+
+	// Materials from every library the file names, next to the file
+	std::vector<std::string> materialNames;
+	std::vector<MeshMaterial> materials;
+	std::string const directory = load.mPath.substr(0, load.mPath.find_last_of("/\\") + 1);
+	for (ObjChunk const& chunk : chunks) {
+		for (std::string const& library : chunk.mLibraries) {
+			LoadMtl(directory + library, materialNames, materials);
+			if (load.mLibraries) {
+				load.mLibraries->push_back(directory + library);
+			}
+		}
+	}
+
+	// One mesh per material in the order they're first used, a run carries on into the next chunk
+	std::vector<std::string> meshNames;
+	std::vector<ObjMesh>& meshes = load.mMeshes;
+	size_t current = 0;
+	for (ObjChunk const& chunk : chunks) {
+		uint32_t const triangleCount = (uint32_t)(chunk.mCorners.size() / 3);
+		for (size_t run = 0; run <= chunk.mRuns.size(); ++run) {
+			if (run > 0) {
+				std::string const& name = chunk.mRuns[run - 1].mName;
+				current = std::find(meshNames.begin(), meshNames.end(), name) - meshNames.begin();
+				if (current == meshNames.size()) {
+					meshNames.push_back(name);
+					meshes.push_back(ObjMesh());
+					size_t const material = std::find(materialNames.begin(), materialNames.end(), name) - materialNames.begin();
+					meshes.back().mMaterial = material < materials.size() ? materials[material] : MeshMaterial();
+				}
+			}
+			uint32_t const first = run > 0 ? chunk.mRuns[run - 1].mFirstTriangle : 0;
+			uint32_t const last = run < chunk.mRuns.size() ? chunk.mRuns[run].mFirstTriangle : triangleCount;
+			if (first < last && meshes.empty()) {
+				meshNames.push_back(std::string());
+				meshes.push_back(ObjMesh());
+			}
+			if (first < last) {
+				ObjRange const range = { chunk.mCorners.data() + 3 * first, chunk.mCorners.data() + 3 * last };
+				meshes[current].mRanges.push_back(range);
+			}
+		}
+	}
+	return true;
+}
+
+// The built meshes copied into the arena. Meshes without triangles are dropped, assimp's importer does the same
+Model* FinishObjModel(ObjLoad& load) {
+	Arena& arena = *load.mArena;
+	std::vector<Mesh*> built;
+	for (ObjMesh& mesh : load.mMeshes) {
+		uint32_t const vertexCount = (uint32_t)mesh.mAttributes[kPosX].size();
+		uint32_t const indexCount = (uint32_t)mesh.mIndices.size();
+		if (indexCount == 0) {
+			continue;
+		}
+		float* attributes[kVertexAttributeCount];
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			attributes[attribute] = arena.NewArray<float>(vertexCount);
+			std::copy(mesh.mAttributes[attribute].begin(), mesh.mAttributes[attribute].end(), attributes[attribute]);
+		}
+		uint32_t* indices = arena.NewArray<uint32_t>(indexCount);
+		std::copy(mesh.mIndices.begin(), mesh.mIndices.end(), indices);
+		Mesh* newMesh = arena.New<Mesh>(attributes, vertexCount, indices, indexCount);
+		newMesh->SetFileMaterial(mesh.mMaterial, arena);
+		built.push_back(newMesh);
+	}
+	Mesh** modelMeshes = arena.NewArray<Mesh*>(built.size());
+	std::copy(built.begin(), built.end(), modelMeshes);
+	return arena.New<Model>(modelMeshes, (uint32_t)built.size());
+}
+
+// Start loading the OBJ at path on pool and return the job that finishes it, which sets *model to the model, one
+// mesh per material, or nullptr if it can't be read. The meshes' BVHs aren't built yet. Each chunk is parsed by a
+// job of its own, a merge job after them joins the chunks and adds a job per mesh to deduplicate its vertices, and
+// the last job depends on those. libraries, when given, gets the paths of the material libraries it read or tried
+// to, which the model's scene cache depends on. It, model and arena have to outlive the jobs
+Job* LoadObjAsync(ThreadPool& pool, std::string const& path, Arena& arena, Model** model, std::vector<std::string>* libraries = nullptr) {
+	*model = nullptr;
+	std::shared_ptr<ObjLoad> load(new ObjLoad());
+	load->mPath = path;
+	load->mArena = &arena;
+	load->mModel = model;
+	load->mLibraries = libraries;
+	load->mValid = true;
+	if (!load->mFile.Open(path.c_str())) {
+		printf("Couldn't open file: %s\n", path.c_str());
+		return pool.Add([]() {});
+	}
+	char const* const data = load->mFile.Data();
+	size_t const size = load->mFile.Size();
+	char const* const end = data + size;
+
+	// Chunks end after a line break, so no line is split
+	size_t const chunkCount = std::max(std::min((size_t)pool.ThreadCount(), size / kObjMinChunkSize), (size_t)1);
+	std::vector<char const*> bounds(chunkCount + 1, end);
+	bounds[0] = data;
+	for (size_t ii = 1; ii < chunkCount; ++ii) {
+		char const* const split = std::max(data + size * ii / chunkCount, bounds[ii - 1]);
+		bounds[ii] = split < end ? SkipObjLine(split, end) : end;
+	}
+	load->mChunks.resize(chunkCount);
+
+	Job* done = pool.Prepare([load]() {
+		TRACE_SCOPE("Finish OBJ");
+		PERF_PHASE(kPerfLoad);
+		if (load->mValid) {
+			*load->mModel = FinishObjModel(*load);
+		}
+	});
+	std::vector<Job*> parses;
+	for (size_t ii = 0; ii < chunkCount; ++ii) {
+		char const* const first = bounds[ii];
+		char const* const last = bounds[ii + 1];
+		parses.push_back(pool.Add([load, ii, first, last]() {
+			TRACE_SCOPE("Parse OBJ", "chunk", (int)ii);
+			PERF_PHASE(kPerfLoad);
+			ParseObjChunk(first, last, load->mChunks[ii]);
+		}));
+	}
+	ThreadPool* const jobs = &pool;
+	Job* merge = pool.Add([load, jobs, done]() {
+		{
+			TRACE_SCOPE("Merge OBJ", "chunks", (int)load->mChunks.size());
+			PERF_PHASE(kPerfLoad);
+			load->mValid = MergeObjChunks(*load);
+		}
+		if (!load->mValid) {
+			return;
+		}
+		for (size_t ii = 0; ii < load->mMeshes.size(); ++ii) {
+			Job* dedup = jobs->Add([load, ii]() {
+				TRACE_SCOPE("Deduplicate vertices", "mesh", (int)ii);
+				PERF_PHASE(kPerfLoad);
+				BuildObjMesh(load->mMeshes[ii], load->mPositions, load->mTexCoords, load->mNormals);
+			});
+			jobs->AddDependency(done, dedup);
+		}
+	}, parses);
+	pool.AddDependency(done, merge);
+	pool.Submit(done);
+	return done;
+}
+
+// LoadObjAsync on pool, or on a pool of its own when that's nullptr, returning once it's done. Not from inside a job
+Model* LoadObj(std::string const& path, Arena& arena, std::vector<std::string>* libraries = nullptr, ThreadPool* pool = nullptr) {
+	TRACE_SCOPE("Load OBJ");
+	std::unique_ptr<ThreadPool> ownPool(pool ? nullptr : new ThreadPool());
+	ThreadPool& jobs = pool ? *pool : *ownPool;
+	Model* model = nullptr;
+	jobs.Wait(LoadObjAsync(jobs, path, arena, &model, libraries));
+	return model;
+}
\ No newline at end of file
@@ -3,10 +3,14 @@
 #include "object.h"
 #include "Box.h"
 #include "BVH.h"
+#include "Arena.h"
 
 int const maxElementsPerLeaf = 8;
 int const maxTreeDepth = 100;
 
+// Octant from GetOctant() for each combination of negative axes, x in bit 0, y in bit 1 and z in bit 2
+int const kOctantFromSigns[8] = { 0, 1, 3, 2, 4, 5, 6, 7 };
+
 class Octree : public AccelerationStructure {
 public:
 	int GetOctant(Vec3 const& octCenter, Vec3 const& triCenter) {
@@ -28,11 +32,11 @@ public:
 			return 7;
 	}
 
-	Octree(std::vector<Object*> const& objIn, int d) : depth(d) {
+	Octree(std::vector<Object*> const& objIn, int d, Arena& arena) : depth(d) {
 
 		// Find the size of this node and allocate the array
 		mElementsCount = objIn.size();
-		mElements = new Object*[mElementsCount];
+		mElements = arena.NewArray<Object*>(mElementsCount);
 		for (int ii = 0; ii < mElementsCount; ++ii) {
 			mElements[ii] = objIn.at(ii);
 			mBoundingBox.Expand(mElements[ii]->mBoundingBox);
@@ -59,7 +63,7 @@ public:
 		// Create the child nodes
 		for (int ii = 0; ii < 8; ++ii) {
 			if (temp[ii].size()) {
-				child[ii] = new Octree(temp[ii], depth + 1);
+				child[ii] = arena.New<Octree>(temp[ii], depth + 1, arena);
 				isLeaf = false;
 			} else {
 				child[ii] = nullptr;
@@ -68,14 +72,16 @@ public:
 	}
 
 	bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const {
+		STAT_INC(kOctreeNodes);
+
 		// Check if volume is hit at all
-		if (!HitBB(r)) {
+		if (!HitBB(r, t_min, t_max)) {
 			return false;
 		}
 
 		HitRecord temp_record;
 		bool hit_anything = false;
-		double closest = t_max;
+		float closest = t_max;
 
 		// Loop through all elements if this is a leaf
 		if (isLeaf) {
@@ -88,12 +94,14 @@ public:
 				}
 			}
 		} else {
-			// Loop through all children otherwise
+			// Loop through all children otherwise, roughly front to back so near hits cull the rest
+			int const nearest = NearestOctantSigns(r.sign);
 			for (int ii = 0; ii < 8; ++ii) {
-				if (!child[ii]) {
+				Octree const* node = child[kOctantFromSigns[nearest ^ ii]];
+				if (!node) {
 					continue;
 				}
-				if (child[ii]->Hit(r, t_min, closest, temp_record)) { // Need to get the t_value to produce a priority queue
+				if (node->Hit(r, t_min, closest, temp_record)) {
 
 					hit_anything = true;
 					closest = temp_record.t;
@@ -105,6 +113,38 @@ public:
 		return hit_anything;
 	}
 
+	// The ray enters on the negative side of each axis it travels along positively. Visiting
+	// nearest ^ 0, nearest ^ 1, ... never puts a child before one that can block it
+	static int NearestOctantSigns(uint8_t const sign[3]) {
+		return (sign[0] ? 0 : 1) | (sign[1] ? 0 : 2) | (sign[2] ? 0 : 4);
+	}
+
+	// Lanes that miss this node drop out, the node is skipped once none are left
+	uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		STAT_ADD(kOctreeNodes, LaneCount(mask));
+
+		uint32_t const active = mBoundingBox.HitPacket(packet, t_min, rec.t, mask);
+		if (!active) {
+			return 0;
+		}
+
+		uint32_t hit = 0;
+		if (isLeaf) {
+			for (int ii = 0; ii < mElementsCount; ++ii) {
+				hit |= mElements[ii]->HitPacket(packet, t_min, rec, active);
+			}
+		} else {
+			int const nearest = NearestOctantSigns(packet.mSign);
+			for (int ii = 0; ii < 8; ++ii) {
+				Octree const* node = child[kOctantFromSigns[nearest ^ ii]];
+				if (node) {
+					hit |= node->HitPacket(packet, t_min, rec, active);
+				}
+			}
+		}
+		return hit;
+	}
+
 	int depth;
 	bool isLeaf;
 	Octree* child[8];
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "util.h"
+
+// Hardware counters per thread for each phase of a run, through Linux perf_event_open. Define PERF_COUNTERS to
+// compile them in, otherwise PERF_PHASE disappears
+#if defined(PERF_COUNTERS)
+#if !defined(__linux__)
+#error "PERF_COUNTERS needs Linux perf_event_open"
+#endif
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum PerfPhase {
+	kPerfNone, // Not counted
+	kPerfLoad,
+	kPerfBuild,
+	kPerfRender,
+	kPerfPhaseCount,
+};
+
+char const* const kPerfPhaseNames[kPerfPhaseCount] = { "none", "load", "build", "render" };
+
+enum PerfCounter {
+	kPerfCycles,
+	kPerfInstructions,
+	kPerfL1DMisses,
+	kPerfLLCMisses,
+	kPerfBranchMisses,
+	kPerfCounterCount,
+};
+
+char const* const kPerfCounterNames[kPerfCounterCount] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+
+// Counts one thread made in each phase
+struct PerfThread {
+	PerfThread() : mPhase(kPerfNone) {
+		for (int phase = 0; phase < kPerfPhaseCount; ++phase) {
+			for (int counter = 0; counter < kPerfCounterCount; ++counter) {
+				mCounts[phase][counter] = 0.0;
+			}
+		}
+		for (int counter = 0; counter < kPerfCounterCount; ++counter) {
+			mFds[counter] = -1;
+			mLast[counter] = 0.0;
+		}
+	}
+
+	std::string mName;
+	PerfPhase mPhase;
+	double mCounts[kPerfPhaseCount][kPerfCounterCount]; // Scaled up for the time a counter was multiplexed out
+	int mFds[kPerfCounterCount];
+	double mLast[kPerfCounterCount];
+};
+
+#if defined(PERF_COUNTERS)
+struct PerfState {
+	std::mutex mLock; // Only taken when a thread makes its counts
+	std::vector<PerfThread*> mThreads;
+	std::atomic<bool> mWarned{ false }; // Workers open counters at once, only the first failure is printed
+};
+
+PerfState gPerf;
+thread_local PerfThread* tPerfThread = nullptr;
+
+PerfThread* GetPerfThread() {
+	if (!tPerfThread) {
+		std::lock_guard<std::mutex> lock(gPerf.mLock);
+		tPerfThread = new PerfThread();
+		tPerfThread->mName = "thread " + std::to_string(gPerf.mThreads.size());
+		gPerf.mThreads.push_back(tPerfThread);
+	}
+	return tPerfThread;
+}
+
+// Counters for the calling thread only, user space only so perf_event_paranoid 2 allows them
+void OpenPerfCounters(PerfThread* thread) {
+	uint32_t const types[kPerfCounterCount] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+	uint64_t const configs[kPerfCounterCount] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+	for (int counter = 0; counter < kPerfCounterCount; ++counter) {
+		perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[counter];
+		attr.config = configs[counter];
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		thread->mFds[counter] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+		thread->mLast[counter] = 0.0;
+		if (thread->mFds[counter] < 0 && !gPerf.mWarned.exchange(true)) {
+			printf("perf_event_open failed for %s, check kernel.perf_event_paranoid\n", kPerfCounterNames[counter]);
+		}
+	}
+}
+
+void ClosePerfCounters(PerfThread* thread) {
+	for (int counter = 0; counter < kPerfCounterCount; ++counter) {
+		if (thread->mFds[counter] >= 0) {
+			close(thread->mFds[counter]);
+			thread->mFds[counter] = -1;
+		}
+	}
+}
+
+// Give what the counters did since the last switch to the phase that was running, then start the next one
+void SwitchPerfPhase(PerfThread* thread, PerfPhase const phase) {
+	for (int counter = 0; counter < kPerfCounterCount; ++counter) {
+		uint64_t values[3]; // Value, time enabled, time running
+		if (thread->mFds[counter] < 0 || read(thread->mFds[counter], values, sizeof(values)) != sizeof(values)) {
+			continue;
+		}
+		double const scaled = values[2] > 0 ? (double)values[0] * ((double)values[1] / (double)values[2]) : 0.0;
+		thread->mCounts[thread->mPhase][counter] += scaled - thread->mLast[counter];
+		thread->mLast[counter] = scaled;
+	}
+	thread->mPhase = phase;
+}
+
+// Counts the enclosing scope as phase, nested scopes take over until they end. Counters are opened by the
+// outermost scope and closed with it, so short lived threads don't hold on to them
+class PerfScope {
+public:
+	PerfScope(PerfPhase const phase) : mThread(GetPerfThread()), mPrevious(mThread->mPhase) {
+		if (mPrevious == kPerfNone) {
+			OpenPerfCounters(mThread);
+		}
+		SwitchPerfPhase(mThread, phase);
+	}
+
+	~PerfScope() {
+		SwitchPerfPhase(mThread, mPrevious);
+		if (mPrevious == kPerfNone) {
+			ClosePerfCounters(mThread);
+		}
+	}
+
+private:
+	PerfThread* mThread;
+	PerfPhase const mPrevious;
+};
+
+#define PERF_CONCAT_INNER(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_INNER(a, b)
+#define PERF_PHASE(phase) PerfScope PERF_CONCAT(perfScope, __LINE__)(phase)
+
+// Label for this thread in the report, number is appended if it isn't negative
+void SetPerfThreadName(char const* name, int const number = -1) {
+	std::string& threadName = GetPerfThread()->mName;
+	threadName = name;
+	if (number >= 0) {
+		threadName += " " + std::to_string(number);
+	}
+}
+
+// Per thread and total counts for each phase with IPC and misses per ray, to stdout and as JSON to path.
+// Call once the counted threads have finished
+void ReportPerfCounters(uint64_t const rays, char const* path) {
+	PerfThread total;
+	total.mName = "total";
+	for (PerfThread const* thread : gPerf.mThreads) {
+		for (int phase = 0; phase < kPerfPhaseCount; ++phase) {
+			for (int counter = 0; counter < kPerfCounterCount; ++counter) {
+				total.mCounts[phase][counter] += thread->mCounts[phase][counter];
+			}
+		}
+	}
+
+	if (total.mCounts[kPerfRender][kPerfCycles] <= 0.0) {
+		printf("No hardware counters were read, perf_event_open may not be supported here\n");
+	}
+
+	FILE* file = OpenFile(path, "w");
+	if (file) {
+		fprintf(file, "{\n\t\"rays\": %llu,\n\t\"threads\": [\n", (unsigned long long)rays);
+	}
+	std::vector<PerfThread const*> rows(gPerf.mThreads.begin(), gPerf.mThreads.end());
+	rows.push_back(&total);
+	for (size_t ii = 0; ii < rows.size(); ++ii) {
+		PerfThread const* thread = rows[ii];
+		if (file) {
+			fprintf(file, "\t\t{ \"name\": \"%s\"", thread->mName.c_str());
+		}
+		for (int phase = kPerfNone + 1; phase < kPerfPhaseCount; ++phase) {
+			double const* counts = thread->mCounts[phase];
+			if (counts[kPerfCycles] <= 0.0) {
+				continue;
+			}
+			double const ipc = counts[kPerfInstructions] / counts[kPerfCycles];
+			printf("%-16s %-6s %14.0f cycles  IPC %.2f  L1D %12.0f  LLC %10.0f  branch %10.0f", thread->mName.c_str(), kPerfPhaseNames[phase],
+				counts[kPerfCycles], ipc, counts[kPerfL1DMisses], counts[kPerfLLCMisses], counts[kPerfBranchMisses]);
+			if (phase == kPerfRender && rays > 0) {
+				printf("  per ray: L1D %.2f  LLC %.3f  branch %.2f", counts[kPerfL1DMisses] / rays, counts[kPerfLLCMisses] / rays, counts[kPerfBranchMisses] / rays);
+			}
+			printf("\n");
+
+			if (file) {
+				fprintf(file, ", \"%s\": { \"ipc\": %.4f", kPerfPhaseNames[phase], ipc);
+				for (int counter = 0; counter < kPerfCounterCount; ++counter) {
+					fprintf(file, ", \"%s\": %.0f", kPerfCounterNames[counter], counts[counter]);
+				}
+				fprintf(file, " }");
+			}
+		}
+		if (file) {
+			fprintf(file, " }%s\n", ii + 1 < rows.size() ? "," : "");
+		}
+	}
+	if (file) {
+		fprintf(file, "\t]\n}\n");
+		fclose(file);
+	} else {
+		printf("Could not write %s\n", path);
+	}
+}
+#else
+#define PERF_PHASE(phase) ((void)0)
+inline void SetPerfThreadName(char const*, int const = -1) {}
+#endif
\ No newline at end of file
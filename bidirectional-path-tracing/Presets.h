@@ -10,7 +10,13 @@ enum Preset {
 	kShadow,
 };
 
-void LoadPreset(World** world, Camera** camera, int const width, int const height, Preset const p) {
+char const* const kPresetNames[] = { "random_scene", "chapter10", "lighting", "shapes", "model", "mirror", "shadow" };
+
+// Start building preset p on pool and return the job that finishes it, with the top level acceleration structure.
+// *camera is set straight away and *world once the job has run, or the job is nullptr if there's no such preset.
+// Models load, and their meshes' BVHs build, as jobs the last one depends on. Everything in the scene goes in one
+// arena the world owns, hugePages backs it with 2MB pages where possible
+Job* LoadPresetAsync(ThreadPool& pool, World** world, Camera** camera, int const width, int const height, Preset const p, bool const hugePages = false) {
 	switch (p) {
 	/*case kRandomScene: {
 		std::vector<Object*> objects;
@@ -190,43 +196,43 @@ void LoadPreset(World** world, Camera** camera, int const width, int const heigh
 		return;
 	}*/
 	case kShadow: {
+		Arena* arena = new Arena(hugePages);
 		std::vector<Object*> objects;
 
 		float const wallShiny = 15.f;
 		Vec3 const wallSpec = Vec3(0.1, 0.1, 0.1);
 
 		// Floor
-		objects.push_back(new Triangle(Vec3(-1, 0, 5), Vec3(1, 0, 5), Vec3(1, 0, -1), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
-		objects.push_back(new Triangle(Vec3(1, 0, -1), Vec3(-1, 0, -1), Vec3(-1, 0, 5), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(-1, 0, 5), Vec3(1, 0, 5), Vec3(1, 0, -1), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(1, 0, -1), Vec3(-1, 0, -1), Vec3(-1, 0, 5), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
 
 		// Left wall
-		objects.push_back(new Triangle(Vec3(-1, 0, 5), Vec3(-1, 0, -1), Vec3(-1, 2, 5), new Solid(Vec3(183.f / 255.f, 33.f / 255.f, 33.f / 255.f), wallSpec, wallShiny)));
-		objects.push_back(new Triangle(Vec3(-1, 0, -1), Vec3(-1, 2, -1), Vec3(-1, 2, 5), new Solid(Vec3(183.f / 255.f, 33.f / 255.f, 33.f / 255.f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(-1, 0, 5), Vec3(-1, 0, -1), Vec3(-1, 2, 5), arena->New<Solid>(Vec3(183.f / 255.f, 33.f / 255.f, 33.f / 255.f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(-1, 0, -1), Vec3(-1, 2, -1), Vec3(-1, 2, 5), arena->New<Solid>(Vec3(183.f / 255.f, 33.f / 255.f, 33.f / 255.f), wallSpec, wallShiny)));
 
 		// Right wall
-		objects.push_back(new Triangle(Vec3(1, 0, 5), Vec3(1, 2, 5), Vec3(1, 0, -1), new Solid(Vec3(40.f / 255.f, 145.f / 255.f, 24.f / 255.f), wallSpec, wallShiny)));
-		objects.push_back(new Triangle(Vec3(1, 2, 5), Vec3(1, 2, -1), Vec3(1, 0, -1), new Solid(Vec3(40.f / 255.f, 145.f / 255.f, 24.f / 255.f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(1, 0, 5), Vec3(1, 2, 5), Vec3(1, 0, -1), arena->New<Solid>(Vec3(40.f / 255.f, 145.f / 255.f, 24.f / 255.f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(1, 2, 5), Vec3(1, 2, -1), Vec3(1, 0, -1), arena->New<Solid>(Vec3(40.f / 255.f, 145.f / 255.f, 24.f / 255.f), wallSpec, wallShiny)));
 
 		// back wall
-		objects.push_back(new Triangle(Vec3(-1, 0, -1), Vec3(1, 0, -1), Vec3(1, 2, -1), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
-		objects.push_back(new Triangle(Vec3(1, 2, -1), Vec3(-1, 2, -1), Vec3(-1, 0, -1), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(-1, 0, -1), Vec3(1, 0, -1), Vec3(1, 2, -1), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(1, 2, -1), Vec3(-1, 2, -1), Vec3(-1, 0, -1), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
 
 		// front wall
-		objects.push_back(new Triangle(Vec3(1, 0, 5), Vec3(-1, 0, 5), Vec3(1, 2, 5), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
-		objects.push_back(new Triangle(Vec3(-1, 2, 5), Vec3(1, 2, 5), Vec3(-1, 0, 5), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(1, 0, 5), Vec3(-1, 0, 5), Vec3(1, 2, 5), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(-1, 2, 5), Vec3(1, 2, 5), Vec3(-1, 0, 5), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
 
 		// Ceiling
-		objects.push_back(new Triangle(Vec3(-1, 2, 5), Vec3(1, 2, -1), Vec3(1, 2, 5), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny))); // TODO: Why are these black?
-		objects.push_back(new Triangle(Vec3(1, 2, -1), Vec3(-1, 2, 5), Vec3(-1, 2, -1), new Solid(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
+		objects.push_back(arena->New<Triangle>(Vec3(-1, 2, 5), Vec3(1, 2, -1), Vec3(1, 2, 5), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny))); // TODO: Why are these black?
+		objects.push_back(arena->New<Triangle>(Vec3(1, 2, -1), Vec3(-1, 2, 5), Vec3(-1, 2, -1), arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), wallSpec, wallShiny)));
 
-		ModelLoader l;
-		Model* cube1 = l.LoadModel("Models/Cube45.obj");
-		cube1->AddMeshes(objects, Vec3(0.4, -0.2f, 0), new Solid(Vec3(0.6f, 0.6f, 0.6f), Vec3(0.6f, 0.6f, 0.6f), 5.f));
+		// The loader's jobs use it, so it lives as long as the scene
+		ModelLoader* l = arena->New<ModelLoader>(*arena, true, true, &pool);
+		PendingModel const* cube1 = l->LoadModelAsync("Models/Cube45.obj");
+		Material* cube1Material = arena->New<Solid>(Vec3(0.6f, 0.6f, 0.6f), Vec3(0.6f, 0.6f, 0.6f), 5.f);
 
 		std::vector<Light*> lights;
-		lights.push_back(new SphereLight(Vec3(0, 1.8f, 0), Vec3(0.2, 0.2f, 0.2), 1.f));
-
-		*world = new World(objects, lights);
+		lights.push_back(arena->New<SphereLight>(Vec3(0, 1.8f, 0), Vec3(0.2, 0.2f, 0.2), 2.f));
 
 		// Set camera location
 		Vec3 cameraLocation(0, 1, 4);
@@ -236,9 +242,26 @@ void LoadPreset(World** world, Camera** camera, int const width, int const heigh
 		float fov = 40.f;
 
 		*camera = new Camera(cameraLocation, lookAt, Vec3(0, 1, 0), fov, (float)width / (float)height, aperture, focal_distance);
-		return;
+
+		return pool.Add([=]() mutable {
+			if (cube1->mModel) {
+				cube1->mModel->AddMeshes(objects, Vec3(0.4, -0.2f, 0), *arena, cube1Material);
+			}
+			*world = new World(objects, lights, arena);
+		}, { cube1->mReady });
 	}
 	default:
-		return;
+		return nullptr;
+	}
+}
+
+// LoadPresetAsync on a pool of its own, returning once the scene is ready. False if there's no such preset
+bool LoadPreset(World** world, Camera** camera, int const width, int const height, Preset const p, bool const hugePages = false) {
+	ThreadPool pool;
+	Job* const ready = LoadPresetAsync(pool, world, camera, width, height, p, hugePages);
+	if (!ready) {
+		return false;
 	}
+	pool.Wait(ready);
+	return true;
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include "ray.h"
+
+// Rays traced together through the acceleration structures, 4, 8 or 16 wide
+#ifndef PACKET_SIZE
+#define PACKET_SIZE 8
+#endif
+
+int const kPacketSize = PACKET_SIZE;
+uint32_t const kPacketFullMask = (uint32_t)((1ull << PACKET_SIZE) - 1);
+
+static_assert(PACKET_SIZE == 4 || PACKET_SIZE == 8 || PACKET_SIZE == 16, "PACKET_SIZE must be 4, 8 or 16");
+
+// Structure of arrays so each component loop over the lanes vectorizes
+class RayPacket {
+public:
+	RayPacket() : mActive(0) {}
+
+	void Set(int const lane, Ray const& r) {
+		Vec3 const& o = r.origin();
+		Vec3 const& d = r.direction();
+		mOriginX[lane] = o.x();
+		mOriginY[lane] = o.y();
+		mOriginZ[lane] = o.z();
+		mDirX[lane] = d.x();
+		mDirY[lane] = d.y();
+		mDirZ[lane] = d.z();
+		mInvDirX[lane] = r.invDir.x();
+		mInvDirY[lane] = r.invDir.y();
+		mInvDirZ[lane] = r.invDir.z();
+		mOriginInvDirX[lane] = r.originInvDir.x();
+		mOriginInvDirY[lane] = r.originInvDir.y();
+		mOriginInvDirZ[lane] = r.originInvDir.z();
+		mActive |= 1u << lane;
+
+		// Coherent lanes share an order to visit children in, take it from the first
+		if (lane == 0) {
+			mSign[0] = r.sign[0];
+			mSign[1] = r.sign[1];
+			mSign[2] = r.sign[2];
+		}
+	}
+
+	Ray GetRay(int const lane) const {
+		return Ray(Vec3(mOriginX[lane], mOriginY[lane], mOriginZ[lane]), Vec3(mDirX[lane], mDirY[lane], mDirZ[lane]));
+	}
+
+	alignas(64) float mOriginX[PACKET_SIZE];
+	alignas(64) float mOriginY[PACKET_SIZE];
+	alignas(64) float mOriginZ[PACKET_SIZE];
+	alignas(64) float mDirX[PACKET_SIZE];
+	alignas(64) float mDirY[PACKET_SIZE];
+	alignas(64) float mDirZ[PACKET_SIZE];
+	alignas(64) float mInvDirX[PACKET_SIZE];
+	alignas(64) float mInvDirY[PACKET_SIZE];
+	alignas(64) float mInvDirZ[PACKET_SIZE];
+	alignas(64) float mOriginInvDirX[PACKET_SIZE];
+	alignas(64) float mOriginInvDirY[PACKET_SIZE];
+	alignas(64) float mOriginInvDirZ[PACKET_SIZE];
+
+	// One bit per lane that holds a ray
+	uint32_t mActive;
+	uint8_t mSign[3];
+};
\ No newline at end of file
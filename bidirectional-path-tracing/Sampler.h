@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "vec2.h"
+
+enum SamplerType {
+	kRandomSampler,
+	kStratifiedSampler,
+	kHaltonSampler,
+	kSobolSampler,
+	kBlueNoiseSampler,
+};
+
+char const* const kSamplerNames[] = { "random", "stratified", "halton", "sobol", "blue_noise" };
+
+// Every use of randomness has a fixed dimension so paths that bounce differently stay aligned
+enum {
+	kPixelDimension = 0, // 2D
+	kLensDimension = 2, // 2D
+	kFirstBounceDimension = 4,
+
+	// Offsets inside each bounce
+	kLightSelectDimension = 0, // 1D
+	kLightPositionDimension = 1, // 2D
+	kBsdfDimension = 3, // 2D
+	kDimensionsPerBounce = 5,
+};
+
+// Integer hash with good avalanche (lowbias32)
+inline uint32_t Hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+inline uint32_t HashCombine(uint32_t const seed, uint32_t const v) {
+	return Hash(seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2)));
+}
+
+// Top 24 bits so the result is strictly below 1
+inline float ToUnitFloat(uint32_t const x) {
+	return (float)(x >> 8) / 16777216.f;
+}
+
+inline uint32_t ReverseBits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+	x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+	x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+	x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+	return x;
+}
+
+// Random permutation of [0, length) without storage (Kensler, Correlated Multi-Jittered Sampling)
+inline uint32_t Permute(uint32_t i, uint32_t const length, uint32_t const p) {
+	uint32_t w = length - 1;
+	w |= w >> 1;
+	w |= w >> 2;
+	w |= w >> 4;
+	w |= w >> 8;
+	w |= w >> 16;
+	do {
+		i ^= p; i *= 0xe170893d;
+		i ^= p >> 16;
+		i ^= (i & w) >> 4;
+		i ^= p >> 8; i *= 0x0929eb3f;
+		i ^= p >> 23;
+		i ^= (i & w) >> 1; i *= 1 | p >> 27;
+		i *= 0x6935fa69;
+		i ^= (i & w) >> 11; i *= 0x74dcb303;
+		i ^= (i & w) >> 2; i *= 0x9e501cc3;
+		i ^= (i & w) >> 2; i *= 0xc860a3df;
+		i &= w;
+		i ^= i >> 5;
+	} while (i >= length);
+	return (i + p) % length;
+}
+
+// Owen scrambling of the bits from the top down (Burley, Practical Hash-based Owen Scrambling)
+inline uint32_t NestedUniformScramble(uint32_t x, uint32_t const seed) {
+	x = ReverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47c;
+	x ^= x * 0xb82f1e52;
+	x ^= x * 0xc7afe638;
+	x ^= x * 0x8d22f6e6;
+	return ReverseBits(x);
+}
+
+// First two Sobol dimensions, van der Corput and its (0,2) partner
+inline uint32_t Sobol(uint32_t index, int const dimension) {
+	if (dimension == 0) {
+		return ReverseBits(index);
+	}
+	uint32_t result = 0;
+	for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+		if (index & 1) {
+			result ^= v;
+		}
+	}
+	return result;
+}
+
+class Sampler {
+public:
+	Sampler(int const samplesPerPixel) : mSamplesPerPixel(samplesPerPixel), mSeed(0), mIndex(0), mPixelX(0), mPixelY(0) {}
+	virtual ~Sampler() {}
+
+	// Everything returned after this depends only on the pixel, the index and the dimension
+	void StartSample(int const x, int const y, int const index) {
+		mSeed = HashCombine(Hash((uint32_t)x), (uint32_t)y);
+		mPixelX = x;
+		mPixelY = y;
+		mIndex = (uint32_t)index;
+	}
+
+	virtual float Get1D(int const dimension) const = 0;
+	virtual Vec2 Get2D(int const dimension) const = 0;
+
+	Vec2 Pixel() const { return Get2D(kPixelDimension); }
+	Vec2 Lens() const { return Get2D(kLensDimension); }
+	float LightSelect(int const depth) const { return Get1D(BounceDimension(depth) + kLightSelectDimension); }
+	Vec2 LightPosition(int const depth) const { return Get2D(BounceDimension(depth) + kLightPositionDimension); }
+	Vec2 Bsdf(int const depth) const { return Get2D(BounceDimension(depth) + kBsdfDimension); }
+
+	static int BounceDimension(int const depth) { return kFirstBounceDimension + depth * kDimensionsPerBounce; }
+
+protected:
+	// Independent uniform value, the fallback for every sampler
+	float Random(int const dimension, uint32_t const component) const {
+		return ToUnitFloat(HashCombine(HashCombine(HashCombine(mSeed, mIndex), (uint32_t)dimension), component));
+	}
+
+	int mSamplesPerPixel;
+	uint32_t mSeed;
+	uint32_t mIndex;
+	int mPixelX;
+	int mPixelY;
+};
+
+class RandomSampler : public Sampler {
+public:
+	RandomSampler(int const samplesPerPixel) : Sampler(samplesPerPixel) {}
+
+	virtual float Get1D(int const dimension) const { return Random(dimension, 0); }
+	virtual Vec2 Get2D(int const dimension) const { return Vec2(Random(dimension, 0), Random(dimension, 1)); }
+};
+
+// Jittered strata, the order is shuffled independently for each dimension
+class StratifiedSampler : public Sampler {
+public:
+	StratifiedSampler(int const samplesPerPixel) : Sampler(samplesPerPixel) {
+		mStrataX = (int)fmax(1.f, floor(sqrt((float)samplesPerPixel)));
+		mStrataY = (samplesPerPixel + mStrataX - 1) / mStrataX;
+	}
+
+	virtual float Get1D(int const dimension) const {
+		uint32_t const count = (uint32_t)mSamplesPerPixel;
+		uint32_t const stratum = Permute(mIndex % count, count, HashCombine(mSeed, (uint32_t)dimension));
+		return (stratum + Random(dimension, 0)) / (float)count;
+	}
+
+	virtual Vec2 Get2D(int const dimension) const {
+		uint32_t const count = (uint32_t)(mStrataX * mStrataY);
+		uint32_t const stratum = Permute(mIndex % count, count, HashCombine(mSeed, (uint32_t)dimension));
+		float const x = (stratum % mStrataX + Random(dimension, 0)) / (float)mStrataX;
+		float const y = (stratum / mStrataX + Random(dimension, 1)) / (float)mStrataY;
+		return Vec2(x, y);
+	}
+
+	int mStrataX;
+	int mStrataY;
+};
+
+// Halton sequence with a per pixel Cranley-Patterson rotation
+class HaltonSampler : public Sampler {
+public:
+	HaltonSampler(int const samplesPerPixel) : Sampler(samplesPerPixel) {}
+
+	virtual float Get1D(int const dimension) const {
+		return Sample(dimension, 0);
+	}
+
+	virtual Vec2 Get2D(int const dimension) const {
+		return Vec2(Sample(dimension, 0), Sample(dimension + 1, 0));
+	}
+
+	float Sample(int const dimension, uint32_t const component) const {
+		if (dimension >= kPrimeCount) {
+			return Random(dimension, component);
+		}
+		float const value = RadicalInverse(kPrimes[dimension], mIndex) + ToUnitFloat(HashCombine(mSeed, (uint32_t)dimension));
+		return value >= 1.f ? value - 1.f : value;
+	}
+
+	static float RadicalInverse(uint32_t const base, uint32_t index) {
+		double const invBase = 1.0 / base;
+		double invBaseN = 1.0;
+		uint64_t reversed = 0;
+		while (index) {
+			uint32_t const next = index / base;
+			reversed = reversed * base + (index - next * base);
+			invBaseN *= invBase;
+			index = next;
+		}
+		return (float)fmin(reversed * invBaseN, 0.99999994);
+	}
+
+	static int const kPrimeCount = 64;
+	static uint32_t const kPrimes[kPrimeCount];
+};
+
+uint32_t const HaltonSampler::kPrimes[HaltonSampler::kPrimeCount] = {
+	2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+	59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+	137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+	227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311,
+};
+
+// Each 2D pair is an Owen scrambled (0,2) Sobol sequence with its own shuffled order
+class SobolSampler : public Sampler {
+public:
+	SobolSampler(int const samplesPerPixel) : Sampler(samplesPerPixel) {}
+
+	virtual float Get1D(int const dimension) const {
+		uint32_t const seed = HashCombine(mSeed, (uint32_t)dimension);
+		uint32_t const index = NestedUniformScramble(mIndex, seed);
+		return ToUnitFloat(NestedUniformScramble(Sobol(index, 0), HashCombine(seed, 1)));
+	}
+
+	virtual Vec2 Get2D(int const dimension) const {
+		uint32_t const seed = HashCombine(mSeed, (uint32_t)dimension);
+		uint32_t const index = NestedUniformScramble(mIndex, seed);
+		return Vec2(ToUnitFloat(NestedUniformScramble(Sobol(index, 0), HashCombine(seed, 1))),
+			ToUnitFloat(NestedUniformScramble(Sobol(index, 1), HashCombine(seed, 2))));
+	}
+};
+
+// Tileable blue noise ranks built with void-and-cluster (Ulichney 1993)
+class BlueNoiseMask {
+public:
+	static int const kSize = 64;
+
+	static BlueNoiseMask const& Get() {
+		static BlueNoiseMask const mask;
+		return mask;
+	}
+
+	float Value(int const x, int const y) const {
+		return mValues[(y & (kSize - 1)) * kSize + (x & (kSize - 1))];
+	}
+
+private:
+	BlueNoiseMask() {
+		int const count = kSize * kSize;
+
+		// Gaussian energy for every toroidal offset
+		float const sigma = 1.5f;
+		std::vector<float> kernel(count);
+		for (int y = 0; y < kSize; ++y) {
+			for (int x = 0; x < kSize; ++x) {
+				float const dx = (float)std::min(x, kSize - x);
+				float const dy = (float)std::min(y, kSize - y);
+				kernel[y * kSize + x] = exp(-(dx * dx + dy * dy) / (2.f * sigma * sigma));
+			}
+		}
+
+		// Start from a random tenth of the pixels
+		std::vector<char> initial(count, 0);
+		std::vector<float> initialEnergy(count, 0.f);
+		int onesCount = 0;
+		for (int ii = 0; ii < count; ++ii) {
+			if (Hash((uint32_t)ii) % 10 == 0) {
+				initial[ii] = 1;
+				Splat(initialEnergy, kernel, ii, 1.f);
+				++onesCount;
+			}
+		}
+
+		// Move points from the tightest cluster to the largest void until they settle
+		for (int iteration = 0; iteration < count; ++iteration) {
+			int const cluster = Extreme(initial, initialEnergy, 1, true);
+			initial[cluster] = 0;
+			Splat(initialEnergy, kernel, cluster, -1.f);
+			int const largestVoid = Extreme(initial, initialEnergy, 0, false);
+			initial[largestVoid] = 1;
+			Splat(initialEnergy, kernel, largestVoid, 1.f);
+			if (largestVoid == cluster) {
+				break;
+			}
+		}
+
+		std::vector<int> rank(count, 0);
+
+		// Rank the initial points by removing the tightest cluster first
+		std::vector<char> pattern = initial;
+		std::vector<float> energy = initialEnergy;
+		for (int r = onesCount - 1; r >= 0; --r) {
+			int const cluster = Extreme(pattern, energy, 1, true);
+			pattern[cluster] = 0;
+			Splat(energy, kernel, cluster, -1.f);
+			rank[cluster] = r;
+		}
+
+		// Rank the rest by filling the largest void
+		for (int r = onesCount; r < count; ++r) {
+			int const largestVoid = Extreme(initial, initialEnergy, 0, false);
+			initial[largestVoid] = 1;
+			Splat(initialEnergy, kernel, largestVoid, 1.f);
+			rank[largestVoid] = r;
+		}
+
+		for (int ii = 0; ii < count; ++ii) {
+			mValues[ii] = (rank[ii] + 0.5f) / (float)count;
+		}
+	}
+
+	static void Splat(std::vector<float>& energy, std::vector<float> const& kernel, int const p, float const sign) {
+		int const px = p % kSize;
+		int const py = p / kSize;
+		for (int y = 0; y < kSize; ++y) {
+			for (int x = 0; x < kSize; ++x) {
+				energy[y * kSize + x] += sign * kernel[((y - py) & (kSize - 1)) * kSize + ((x - px) & (kSize - 1))];
+			}
+		}
+	}
+
+	// Highest or lowest energy among the pixels set to value
+	static int Extreme(std::vector<char> const& pattern, std::vector<float> const& energy, char const value, bool const highest) {
+		int best = -1;
+		for (int ii = 0; ii < (int)pattern.size(); ++ii) {
+			if (pattern[ii] != value) {
+				continue;
+			}
+			if (best < 0 || (highest ? energy[ii] > energy[best] : energy[ii] < energy[best])) {
+				best = ii;
+			}
+		}
+		return best;
+	}
+
+	float mValues[kSize * kSize];
+};
+
+// Owen scrambled Sobol shared by every pixel, shifted per pixel by a blue noise mask so the error is
+// pushed to high frequencies on screen
+class BlueNoiseSampler : public Sampler {
+public:
+	BlueNoiseSampler(int const samplesPerPixel) : Sampler(samplesPerPixel), mMask(BlueNoiseMask::Get()) {}
+
+	virtual float Get1D(int const dimension) const {
+		uint32_t const seed = Hash((uint32_t)dimension);
+		return Shift(ToUnitFloat(NestedUniformScramble(Sobol(mIndex, 0), seed)), dimension, 0);
+	}
+
+	virtual Vec2 Get2D(int const dimension) const {
+		uint32_t const seed = Hash((uint32_t)dimension);
+		return Vec2(Shift(ToUnitFloat(NestedUniformScramble(Sobol(mIndex, 0), HashCombine(seed, 1))), dimension, 0),
+			Shift(ToUnitFloat(NestedUniformScramble(Sobol(mIndex, 1), HashCombine(seed, 2))), dimension, 1));
+	}
+
+	// Each dimension reads the mask at its own offset so they don't share a pattern
+	float Shift(float const value, int const dimension, uint32_t const component) const {
+		uint32_t const offset = HashCombine((uint32_t)dimension, component);
+		float const shifted = value + mMask.Value(mPixelX + (int)(offset & 0xff), mPixelY + (int)((offset >> 8) & 0xff));
+		return shifted >= 1.f ? shifted - 1.f : shifted;
+	}
+
+	BlueNoiseMask const& mMask;
+};
+
+Sampler* CreateSampler(SamplerType const type, int const samplesPerPixel) {
+	switch (type) {
+	case kStratifiedSampler:
+		return new StratifiedSampler(samplesPerPixel);
+	case kHaltonSampler:
+		return new HaltonSampler(samplesPerPixel);
+	case kSobolSampler:
+		return new SobolSampler(samplesPerPixel);
+	case kBlueNoiseSampler:
+		return new BlueNoiseSampler(samplesPerPixel);
+	default:
+		return new RandomSampler(samplesPerPixel);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "Arena.h"
+#include "MappedFile.h"
+#include "Model.h"
+#include "Trace.h"
+#include "util.h"
+
+// Binary cache of a model's final vertex and index buffers and flattened BVHs, written next to the model the first
+// time it's imported. Loading maps the file and points the meshes straight at it, nothing is parsed or copied
+
+// Bump when the layout below or how meshes and BVHs are built changes, caches from before are then rebuilt
+uint32_t const kSceneCacheVersion = 6;
+char const kSceneCacheMagic[8] = { 'B', 'P', 'T', 'C', 'A', 'C', 'H', 'E' };
+uint32_t const kSceneCacheByteOrder = 0x01020304;
+uint64_t const kSceneCacheAlignment = 64; // Every array starts on a cache line
+char const* const kSceneCacheExtension = ".bptcache";
+
+// Followed by mSourceCount SceneCacheSourceEntry and then mMeshCount SceneCacheMesh
+struct SceneCacheHeader {
+	char mMagic[8];
+	uint32_t mVersion;
+	uint32_t mByteOrder;
+	uint32_t mNodeSize; // sizeof(BVHNode) and sizeof(BVHTriangle) in the build that wrote it
+	uint32_t mTriangleSize;
+	uint32_t mImportFlags;
+	uint32_t mMeshCount;
+	uint32_t mSourceCount;
+	uint32_t mReserved;
+	uint64_t mFileSize;
+};
+
+// A file the cache was built from, the model first and then every material library its import read. A cache is
+// only used while all of them are unchanged
+struct SceneCacheSourceEntry {
+	uint64_t mHash;
+	uint64_t mSize; // The file's stamp when the cache was last checked against it, see SceneCacheSource
+	int64_t mModified;
+	char mName[232]; // Relative to the model's directory
+};
+
+// Where one mesh's arrays are, as offsets from the start of the file
+struct SceneCacheMesh {
+	uint32_t mVertexCount;
+	uint32_t mIndexCount;
+	uint32_t mNodeCount;
+	uint32_t mTriangleCount;
+	uint64_t mAttributes[kVertexAttributeCount];
+	uint64_t mIndices;
+	uint64_t mNodes;
+	uint64_t mTriangles;
+	MeshMaterial mMaterial;
+};
+
+// 64 bit hash of data, eight bytes at a time. Only tells changed files apart, it isn't meant to resist anyone
+uint64_t HashBytes(void const* data, size_t const size) {
+	uint64_t const prime = 0x100000001b3ull;
+	uint64_t hash = 0xcbf29ce484222325ull ^ size;
+	char const* bytes = (char const*)data;
+	size_t ii = 0;
+	for (; ii + 8 <= size; ii += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + ii, 8);
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 32;
+	}
+	for (; ii < size; ++ii) {
+		hash = (hash ^ (uint8_t)bytes[ii]) * prime;
+	}
+	return hash;
+}
+
+// Stamp of a file that wasn't there, which a cache records so the file turning up makes it stale
+FileStamp const kMissingFileStamp = { UINT64_MAX, 0 };
+
+// A file a cache is built from. A cache whose stamp matches the file's is taken as it is, the contents are only
+// hashed when the stamp differs, so loading from a cache never reads the model or its materials
+struct SceneCacheSource {
+	std::string mPath;
+	FileStamp mStamp;
+	uint64_t mHash;
+	bool mHashed;
+};
+
+// False if there's no file at path, its stamp is kMissingFileStamp then
+bool OpenSceneCacheSource(std::string const& path, SceneCacheSource& source) {
+	source.mPath = path;
+	source.mHash = 0;
+	source.mHashed = false;
+	if (!ReadFileStamp(path.c_str(), source.mStamp)) {
+		source.mStamp = kMissingFileStamp;
+		return false;
+	}
+	return true;
+}
+
+// Reads and hashes the file the first time, false if it can't be opened
+bool HashSceneCacheSource(SceneCacheSource& source) {
+	if (source.mHashed) {
+		return true;
+	}
+	TRACE_SCOPE("Hash source");
+	MappedFile file;
+	if (!file.Open(source.mPath.c_str())) {
+		return false;
+	}
+	source.mHash = HashBytes(file.Data(), file.Size());
+	source.mHashed = true;
+	return true;
+}
+
+// Whether source is still the file entry recorded. When only its stamp changed, like after the file was copied
+// or checked out again, entry takes the new stamp and stale is set so it can be written back
+bool SceneCacheSourceMatches(SceneCacheSource& source, SceneCacheSourceEntry& entry, bool& stale) {
+	FileStamp const stamp = { entry.mSize, entry.mModified };
+	if (stamp == source.mStamp) {
+		return true;
+	}
+	if (stamp == kMissingFileStamp || !HashSceneCacheSource(source) || entry.mHash != source.mHash) {
+		return false;
+	}
+	entry.mSize = source.mStamp.mSize;
+	entry.mModified = source.mStamp.mModified;
+	stale = true;
+	return true;
+}
+
+std::string SceneCacheDirectory(std::string const& modelPath) {
+	return modelPath.substr(0, modelPath.find_last_of("/\\") + 1);
+}
+
+uint64_t AlignCacheOffset(uint64_t const offset) {
+	return (offset + kSceneCacheAlignment - 1) & ~(kSceneCacheAlignment - 1);
+}
+
+// Zeros up to offset, then size bytes of data
+bool WriteCacheArray(FILE* file, uint64_t& position, uint64_t const offset, void const* data, uint64_t const size) {
+	char const zeros[kSceneCacheAlignment] = {};
+	if (offset < position || fwrite(zeros, 1, (size_t)(offset - position), file) != offset - position) {
+		return false;
+	}
+	position = offset + size;
+	return size == 0 || fwrite(data, 1, (size_t)size, file) == size;
+}
+
+// Written to a temporary file first, so a run that stops halfway never leaves a cache that looks valid. sources are
+// the model and then the files next to it that its import read, each hashed or missing
+bool WriteSceneCache(std::string const& path, std::vector<SceneCacheSource> const& sources, uint32_t const importFlags, Model const& model) {
+	TRACE_SCOPE("Write scene cache", "meshes", (int)model.mMeshCount);
+
+	std::string const directory = SceneCacheDirectory(sources[0].mPath);
+	std::vector<SceneCacheSourceEntry> entries(sources.size());
+	for (size_t ii = 0; ii < sources.size(); ++ii) {
+		SceneCacheSource const& source = sources[ii];
+		SceneCacheSourceEntry& entry = entries[ii];
+		std::string const name = source.mPath.substr(directory.size());
+		if (source.mPath.compare(0, directory.size(), directory) != 0 || name.size() >= sizeof(entry.mName)) {
+			return false;
+		}
+		memset(entry.mName, 0, sizeof(entry.mName));
+		memcpy(entry.mName, name.c_str(), name.size());
+		entry.mHash = source.mHashed ? source.mHash : 0;
+		entry.mSize = source.mHashed ? source.mStamp.mSize : kMissingFileStamp.mSize;
+		entry.mModified = source.mHashed ? source.mStamp.mModified : kMissingFileStamp.mModified;
+	}
+
+	SceneCacheHeader header;
+	memcpy(header.mMagic, kSceneCacheMagic, sizeof(header.mMagic));
+	header.mVersion = kSceneCacheVersion;
+	header.mByteOrder = kSceneCacheByteOrder;
+	header.mNodeSize = sizeof(BVHNode);
+	header.mTriangleSize = sizeof(BVHTriangle);
+	header.mImportFlags = importFlags;
+	header.mMeshCount = model.mMeshCount;
+	header.mSourceCount = (uint32_t)entries.size();
+	header.mReserved = 0;
+
+	std::vector<SceneCacheMesh> meshes(model.mMeshCount);
+	uint64_t const meshesStart = sizeof(SceneCacheHeader) + entries.size() * sizeof(SceneCacheSourceEntry);
+	uint64_t offset = AlignCacheOffset(meshesStart + meshes.size() * sizeof(SceneCacheMesh));
+	for (uint32_t ii = 0; ii < model.mMeshCount; ++ii) {
+		Mesh const* mesh = model.mMeshes[ii];
+		SceneCacheMesh& entry = meshes[ii];
+		entry.mVertexCount = (uint32_t)mesh->mVertices.Size();
+		entry.mIndexCount = mesh->mIndexCount;
+		entry.mNodeCount = mesh->mAccelerationStructure->mNodeCount;
+		entry.mTriangleCount = mesh->mAccelerationStructure->mTriangleCount;
+		entry.mMaterial = mesh->mFileMaterial;
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			entry.mAttributes[attribute] = offset;
+			offset = AlignCacheOffset(offset + entry.mVertexCount * sizeof(float));
+		}
+		entry.mIndices = offset;
+		offset = AlignCacheOffset(offset + entry.mIndexCount * sizeof(uint32_t));
+		entry.mNodes = offset;
+		offset = AlignCacheOffset(offset + entry.mNodeCount * sizeof(BVHNode));
+		entry.mTriangles = offset;
+		offset = AlignCacheOffset(offset + entry.mTriangleCount * sizeof(BVHTriangle));
+	}
+	header.mFileSize = offset;
+
+	std::string const tempPath = path + ".tmp";
+	FILE* file = OpenFile(tempPath.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	uint64_t position = 0;
+	bool ok = WriteCacheArray(file, position, 0, &header, sizeof(header));
+	ok = ok && WriteCacheArray(file, position, position, entries.data(), entries.size() * sizeof(SceneCacheSourceEntry));
+	ok = ok && WriteCacheArray(file, position, meshesStart, meshes.data(), meshes.size() * sizeof(SceneCacheMesh));
+	for (uint32_t ii = 0; ii < model.mMeshCount && ok; ++ii) {
+		Mesh const* mesh = model.mMeshes[ii];
+		SceneCacheMesh const& entry = meshes[ii];
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			ok = ok && WriteCacheArray(file, position, entry.mAttributes[attribute], mesh->mVertices.Attribute((VertexAttribute)attribute), entry.mVertexCount * sizeof(float));
+		}
+		ok = ok && WriteCacheArray(file, position, entry.mIndices, mesh->mIndices, entry.mIndexCount * sizeof(uint32_t));
+		ok = ok && WriteCacheArray(file, position, entry.mNodes, mesh->mAccelerationStructure->mNodes, entry.mNodeCount * sizeof(BVHNode));
+		ok = ok && WriteCacheArray(file, position, entry.mTriangles, mesh->mAccelerationStructure->mTriangles, entry.mTriangleCount * sizeof(BVHTriangle));
+	}
+	ok = ok && WriteCacheArray(file, position, header.mFileSize, nullptr, 0);
+	ok = fclose(file) == 0 && ok;
+
+	// rename won't replace a file on Windows
+	remove(path.c_str());
+	if (!ok || rename(tempPath.c_str(), path.c_str()) != 0) {
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool CacheArrayFits(MappedFile const& file, uint64_t const offset, uint64_t const size) {
+	return offset % kSceneCacheAlignment == 0 && offset <= file.Size() && size <= file.Size() - offset;
+}
+
+// Whether the cache at path was built from model with importFlags, and from the material libraries it lists as
+// they are now. Stamps that changed on files whose contents didn't are written back, so the next load doesn't
+// have to hash them
+bool SceneCacheMatches(std::string const& path, SceneCacheSource& model, uint32_t const importFlags) {
+	FILE* file = OpenFile(path.c_str(), "rb");
+	if (!file) {
+		return false;
+	}
+	SceneCacheHeader header;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1
+		&& memcmp(header.mMagic, kSceneCacheMagic, sizeof(header.mMagic)) == 0
+		&& header.mVersion == kSceneCacheVersion
+		&& header.mByteOrder == kSceneCacheByteOrder
+		&& header.mNodeSize == sizeof(BVHNode)
+		&& header.mTriangleSize == sizeof(BVHTriangle)
+		&& header.mImportFlags == importFlags
+		&& header.mSourceCount > 0
+		&& header.mSourceCount <= header.mFileSize / sizeof(SceneCacheSourceEntry);
+	std::vector<SceneCacheSourceEntry> entries(valid ? header.mSourceCount : 0);
+	valid = valid && fread(entries.data(), sizeof(SceneCacheSourceEntry), entries.size(), file) == entries.size();
+	fclose(file);
+
+	bool stale = false;
+	valid = valid && SceneCacheSourceMatches(model, entries[0], stale);
+	std::string const directory = SceneCacheDirectory(model.mPath);
+	for (size_t ii = 1; valid && ii < entries.size(); ++ii) {
+		entries[ii].mName[sizeof(entries[ii].mName) - 1] = '\0';
+		SceneCacheSource library;
+		OpenSceneCacheSource(directory + entries[ii].mName, library);
+		valid = SceneCacheSourceMatches(library, entries[ii], stale);
+	}
+	if (!valid) {
+		return false;
+	}
+
+	// Not being able to update the stamps only costs the next load a hash
+	if (stale) {
+		file = OpenFile(path.c_str(), "r+b");
+		if (file) {
+			if (fseek(file, sizeof(SceneCacheHeader), SEEK_SET) == 0) {
+				fwrite(entries.data(), sizeof(SceneCacheSourceEntry), entries.size(), file);
+			}
+			fclose(file);
+		}
+	}
+	return true;
+}
+
+// The model in the cache at path, or nullptr if there isn't one for this model and these import flags. The
+// mapping lives in arena with the meshes that point into it
+Model* LoadSceneCache(std::string const& path, SceneCacheSource& model, uint32_t const importFlags, Arena& arena) {
+	TRACE_SCOPE("Load scene cache");
+
+	if (!SceneCacheMatches(path, model, importFlags)) {
+		return nullptr;
+	}
+	MappedFile* file = arena.New<MappedFile>();
+	if (!file->Open(path.c_str())) {
+		return nullptr;
+	}
+
+	SceneCacheHeader const* header = (SceneCacheHeader const*)file->Data();
+	uint64_t const meshesStart = sizeof(SceneCacheHeader) + (uint64_t)header->mSourceCount * sizeof(SceneCacheSourceEntry);
+	bool valid = file->Size() >= sizeof(SceneCacheHeader)
+		&& header->mFileSize == file->Size()
+		&& meshesStart <= file->Size()
+		&& (uint64_t)header->mMeshCount * sizeof(SceneCacheMesh) <= file->Size() - meshesStart;
+
+	SceneCacheMesh const* entries = (SceneCacheMesh const*)(file->Data() + meshesStart);
+	for (uint32_t ii = 0; valid && ii < header->mMeshCount; ++ii) {
+		SceneCacheMesh const& entry = entries[ii];
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			valid = valid && CacheArrayFits(*file, entry.mAttributes[attribute], (uint64_t)entry.mVertexCount * sizeof(float));
+		}
+		valid = valid && CacheArrayFits(*file, entry.mIndices, (uint64_t)entry.mIndexCount * sizeof(uint32_t))
+			&& CacheArrayFits(*file, entry.mNodes, (uint64_t)entry.mNodeCount * sizeof(BVHNode))
+			&& CacheArrayFits(*file, entry.mTriangles, (uint64_t)entry.mTriangleCount * sizeof(BVHTriangle));
+	}
+	if (!valid) {
+		file->Close();
+		return nullptr;
+	}
+
+	char* const data = file->Data();
+	uint32_t const meshCount = header->mMeshCount;
+	Mesh** meshes = arena.NewArray<Mesh*>(meshCount);
+	for (uint32_t ii = 0; ii < meshCount; ++ii) {
+		SceneCacheMesh const& entry = entries[ii];
+		float* attributes[kVertexAttributeCount];
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			attributes[attribute] = (float*)(data + entry.mAttributes[attribute]);
+		}
+		BVH* bvh = arena.New<BVH>((BVHNode*)(data + entry.mNodes), entry.mNodeCount, (BVHTriangle*)(data + entry.mTriangles), entry.mTriangleCount);
+		meshes[ii] = arena.New<Mesh>(attributes, entry.mVertexCount, (uint32_t*)(data + entry.mIndices), entry.mIndexCount, bvh);
+		meshes[ii]->SetFileMaterial(entry.mMaterial, arena);
+	}
+	return arena.New<Model>(meshes, meshCount);
+}
\ No newline at end of file
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Arena.h"
+#include "MappedFile.h"
+#include "camera.h"
+#include "sphere.h"
+#include "triangle.h"
+#include "ModelLoader.h"
+#include "ObjLoader.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "World.h"
+
+// Text scene description, so scenes can change without a rebuild. One statement per line, # starts a comment,
+// names have no spaces and a vector is three numbers:
+//
+//   camera <from> <at> <up> <fov> <aperture> [focus distance, |from - at| if it's left out]
+//   material <name> solid <diffuse> <specular> <shininess>
+//   material <name> flat <color>
+//   material <name> metal <albedo> <fuzz>
+//   material <name> dielectric <refractive index>
+//   sphere <center> <radius> <material>
+//   triangle <a> <b> <c> <material>
+//   light sphere|box <center> <size> <intensity>
+//   model <path> <translation> [material, the file's own or plain grey if it's left out]
+//   blob <path>
+//   mesh <offset> <vertex count> <index count> <material>
+//
+// Materials are named before they're used and paths are relative to the scene file. Large geometry goes in a
+// blob, a binary file that's mapped and used in place by the mesh statements after it. A mesh at offset, which is
+// a multiple of 4, is every vertex attribute in VertexAttribute order as vertex count little endian floats, then
+// index count uint32 indices with three per triangle
+
+// Reads a mapped scene a line at a time and a word at a time, without copying anything it doesn't keep
+class SceneReader {
+public:
+	SceneReader(char const* begin, char const* end) : mNext(begin), mEnd(end), mP(begin), mLineEnd(begin), mLine(0) {}
+
+	// Move to the next line with anything on it, false at the end of the file
+	bool NextLine() {
+		while (mNext < mEnd) {
+			mP = mNext;
+			char const* const newline = (char const*)memchr(mP, '\n', mEnd - mP);
+			mLineEnd = newline ? newline : mEnd;
+			mNext = newline ? newline + 1 : mEnd;
+			++mLine;
+			if (!AtLineEnd()) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Whether there's nothing left on the line but spaces and a comment
+	bool AtLineEnd() {
+		mP = SkipObjSpaces(mP, mLineEnd);
+		return mP == mLineEnd || *mP == '#';
+	}
+
+	bool Word(std::string& word) {
+		if (AtLineEnd()) {
+			return false;
+		}
+		char const* const begin = mP;
+		while (mP < mLineEnd && *mP != ' ' && *mP != '\t' && *mP != '\r' && *mP != '#') {
+			++mP;
+		}
+		word.assign(begin, mP);
+		return true;
+	}
+
+	// False unless the word is a number with at least one digit before any exponent, so a lone sign or point
+	// isn't taken as 0
+	bool Number(float& value) {
+		if (AtLineEnd()) {
+			return false;
+		}
+		char const* const begin = mP;
+		value = ParseObjFloat(mP, mLineEnd);
+		bool digits = false;
+		for (char const* p = begin; p < mP && *p != 'e' && *p != 'E'; ++p) {
+			digits |= *p >= '0' && *p <= '9';
+		}
+		return digits && AtWordEnd();
+	}
+
+	bool Vector(Vec3& value) {
+		float x, y, z;
+		if (!Number(x) || !Number(y) || !Number(z)) {
+			return false;
+		}
+		value = Vec3(x, y, z);
+		return true;
+	}
+
+	// False for anything but digits, or a count that doesn't fit
+	bool Count(uint64_t& value) {
+		if (AtLineEnd() || *mP < '0' || *mP > '9') {
+			return false;
+		}
+		value = 0;
+		for (; mP < mLineEnd && *mP >= '0' && *mP <= '9'; ++mP) {
+			uint64_t const digit = (uint64_t)(*mP - '0');
+			if (value > (UINT64_MAX - digit) / 10) {
+				return false;
+			}
+			value = value * 10 + digit;
+		}
+		return AtWordEnd();
+	}
+
+	int Line() const { return mLine; }
+
+private:
+	bool AtWordEnd() const {
+		return mP == mLineEnd || *mP == ' ' || *mP == '\t' || *mP == '\r' || *mP == '#';
+	}
+
+	char const* mNext; // Start of the next line
+	char const* mEnd;
+	char const* mP;
+	char const* mLineEnd;
+	int mLine;
+};
+
+// A model statement, loaded once the whole file has parsed
+struct ScenePlacement {
+	std::string mPath;
+	Vec3 mTranslation;
+	Material* mMaterial;
+	int mLine; // For reporting a model that doesn't load
+};
+
+// Everything in a scene file that's built straight away, in arena
+struct ParsedScene {
+	std::vector<Object*> mObjects;
+	std::vector<Light*> mLights;
+	std::vector<ScenePlacement> mModels;
+	std::vector<Mesh*> mMeshes; // From blobs, still without BVHs
+	Camera* mCamera;
+};
+
+// Directory part of path, with its separator, so relative paths can be appended to it
+std::string SceneDirectory(std::string const& path) {
+	size_t const separator = path.find_last_of("/\\");
+	return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+}
+
+// Parse one statement, the reader is past its keyword. error says what's wrong when it returns false
+bool ParseSceneStatement(SceneReader& reader, std::string const& keyword, std::string const& directory, int const width, int const height,
+	Arena& arena, std::unordered_map<std::string, Material*>& materials, MappedFile*& blob, ParsedScene& scene, std::string& error) {
+	// The material named next on the line, which has to exist already
+	auto const parseMaterial = [&](Material*& material) {
+		std::string name;
+		if (!reader.Word(name)) {
+			error = "expected a material";
+			return false;
+		}
+		auto const found = materials.find(name);
+		if (found == materials.end()) {
+			error = "unknown material " + name;
+			return false;
+		}
+		material = found->second;
+		return true;
+	};
+
+	if (keyword == "camera") {
+		Vec3 from, at, up;
+		float fov, aperture;
+		if (!reader.Vector(from) || !reader.Vector(at) || !reader.Vector(up) || !reader.Number(fov) || !reader.Number(aperture)) {
+			error = "expected camera <from> <at> <up> <fov> <aperture> [focus distance]";
+			return false;
+		}
+		float focus = (from - at).length();
+		if (!reader.AtLineEnd() && !reader.Number(focus)) {
+			error = "expected a focus distance";
+			return false;
+		}
+		delete scene.mCamera;
+		scene.mCamera = new Camera(from, at, up, fov, (float)width / (float)height, aperture, focus);
+	}
+	else if (keyword == "material") {
+		std::string name, type;
+		if (!reader.Word(name) || !reader.Word(type)) {
+			error = "expected material <name> <type> ...";
+			return false;
+		}
+		Material* material = nullptr;
+		if (type == "solid") {
+			Vec3 diffuse, specular;
+			float shininess;
+			if (reader.Vector(diffuse) && reader.Vector(specular) && reader.Number(shininess)) {
+				material = arena.New<Solid>(diffuse, specular, shininess);
+			}
+		}
+		else if (type == "flat") {
+			Vec3 color;
+			if (reader.Vector(color)) {
+				material = arena.New<FlatColor>(color);
+			}
+		}
+		else if (type == "metal") {
+			Vec3 albedo;
+			float fuzz;
+			if (reader.Vector(albedo) && reader.Number(fuzz)) {
+				material = arena.New<Metal>(albedo, fuzz);
+			}
+		}
+		else if (type == "dielectric") {
+			float refractiveIndex;
+			if (reader.Number(refractiveIndex)) {
+				material = arena.New<Dielectric>(refractiveIndex);
+			}
+		}
+		else {
+			error = "unknown material type " + type;
+			return false;
+		}
+		if (!material) {
+			error = "bad " + type + " material";
+			return false;
+		}
+		materials[name] = material;
+	}
+	else if (keyword == "sphere") {
+		Vec3 center;
+		float radius;
+		Material* material;
+		if (!reader.Vector(center) || !reader.Number(radius)) {
+			error = "expected sphere <center> <radius> <material>";
+			return false;
+		}
+		if (!parseMaterial(material)) {
+			return false;
+		}
+		scene.mObjects.push_back(arena.New<Sphere>(center, radius, material));
+	}
+	else if (keyword == "triangle") {
+		Vec3 a, b, c;
+		Material* material;
+		if (!reader.Vector(a) || !reader.Vector(b) || !reader.Vector(c)) {
+			error = "expected triangle <a> <b> <c> <material>";
+			return false;
+		}
+		if (!parseMaterial(material)) {
+			return false;
+		}
+		scene.mObjects.push_back(arena.New<Triangle>(a, b, c, material));
+	}
+	else if (keyword == "light") {
+		std::string type;
+		Vec3 center, size;
+		float intensity;
+		if (!reader.Word(type) || !reader.Vector(center) || !reader.Vector(size) || !reader.Number(intensity)) {
+			error = "expected light sphere|box <center> <size> <intensity>";
+			return false;
+		}
+		if (type == "sphere") {
+			scene.mLights.push_back(arena.New<SphereLight>(center, size, intensity));
+		}
+		else if (type == "box") {
+			scene.mLights.push_back(arena.New<BoxLight>(center, size, intensity));
+		}
+		else {
+			error = "unknown light type " + type;
+			return false;
+		}
+	}
+	else if (keyword == "model") {
+		ScenePlacement placement;
+		placement.mMaterial = nullptr;
+		placement.mLine = reader.Line();
+		if (!reader.Word(placement.mPath) || !reader.Vector(placement.mTranslation)) {
+			error = "expected model <path> <translation> [material]";
+			return false;
+		}
+		if (!reader.AtLineEnd() && !parseMaterial(placement.mMaterial)) {
+			return false;
+		}
+		placement.mPath = directory + placement.mPath;
+		scene.mModels.push_back(placement);
+	}
+	else if (keyword == "blob") {
+		std::string path;
+		if (!reader.Word(path)) {
+			error = "expected blob <path>";
+			return false;
+		}
+		// Meshes point into it, so it lives in the arena
+		blob = arena.New<MappedFile>();
+		if (!blob->Open((directory + path).c_str())) {
+			error = "couldn't open blob " + directory + path;
+			return false;
+		}
+	}
+	else if (keyword == "mesh") {
+		uint64_t offset, vertexCount, indexCount;
+		Material* material;
+		if (!reader.Count(offset) || !reader.Count(vertexCount) || !reader.Count(indexCount)) {
+			error = "expected mesh <offset> <vertex count> <index count> <material>";
+			return false;
+		}
+		if (!parseMaterial(material)) {
+			return false;
+		}
+		if (!blob) {
+			error = "mesh before any blob";
+			return false;
+		}
+		uint64_t const size = vertexCount * kVertexAttributeCount * sizeof(float) + indexCount * sizeof(uint32_t);
+		if (offset % 4 != 0 || vertexCount > UINT32_MAX || indexCount > UINT32_MAX || indexCount % 3 != 0
+			|| offset > blob->Size() || size > blob->Size() - offset) {
+			error = "mesh doesn't fit in the blob";
+			return false;
+		}
+
+		float* attributes[kVertexAttributeCount];
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			attributes[attribute] = (float*)(blob->Data() + offset + attribute * vertexCount * sizeof(float));
+		}
+		uint32_t* indices = (uint32_t*)(blob->Data() + offset + kVertexAttributeCount * vertexCount * sizeof(float));
+		for (uint64_t ii = 0; ii < indexCount; ++ii) {
+			if (indices[ii] >= vertexCount) {
+				error = "mesh index out of range";
+				return false;
+			}
+		}
+		Mesh* mesh = arena.New<Mesh>(attributes, (uint32_t)vertexCount, indices, (uint32_t)indexCount);
+		mesh->material = material;
+		scene.mMeshes.push_back(mesh);
+	}
+	else {
+		error = "unknown statement " + keyword;
+		return false;
+	}
+
+	if (!reader.AtLineEnd()) {
+		error = "unexpected text after " + keyword;
+		return false;
+	}
+	return true;
+}
+
+// Start loading the scene file at path on pool and return the job that finishes it, with the top level
+// acceleration structure, or nullptr if the file can't be read or parsed. The file itself is parsed before this
+// returns and *camera set, then models load and meshes' BVHs build as jobs the last one depends on. *world is set
+// once that's run, or left nullptr if a model couldn't be loaded. hugePages backs the scene's arena with 2MB pages
+// where possible
+Job* LoadSceneAsync(ThreadPool& pool, std::string const& path, World** world, Camera** camera, int const width, int const height, bool const hugePages = false) {
+	*world = nullptr;
+	Arena* arena = new Arena(hugePages);
+	ParsedScene scene;
+	scene.mCamera = nullptr;
+	{
+		TRACE_SCOPE("Parse scene");
+		MappedFile file;
+		if (!file.Open(path.c_str())) {
+			printf("Couldn't open scene: %s\n", path.c_str());
+			delete arena;
+			return nullptr;
+		}
+
+		std::string const directory = SceneDirectory(path);
+		std::unordered_map<std::string, Material*> materials;
+		MappedFile* blob = nullptr;
+		SceneReader reader(file.Data(), file.Data() + file.Size());
+		std::string keyword;
+		std::string error;
+		while (reader.NextLine()) {
+			reader.Word(keyword);
+			if (!ParseSceneStatement(reader, keyword, directory, width, height, *arena, materials, blob, scene, error)) {
+				printf("%s:%d: %s\n", path.c_str(), reader.Line(), error.c_str());
+				delete scene.mCamera;
+				delete arena;
+				return nullptr;
+			}
+		}
+		if (!scene.mCamera) {
+			printf("%s: no camera\n", path.c_str());
+			delete arena;
+			return nullptr;
+		}
+	}
+	*camera = scene.mCamera;
+
+	// Nothing is loaded until the file has parsed, so a bad scene never leaves jobs using its arena
+	ModelLoader* loader = arena->New<ModelLoader>(*arena, true, true, &pool);
+	std::vector<PendingModel const*> models;
+	std::vector<Job*> dependencies;
+	std::vector<Job*> done; // Everything that uses the arena
+	for (ScenePlacement const& placement : scene.mModels) {
+		models.push_back(loader->LoadModelAsync(placement.mPath));
+		dependencies.push_back(models.back()->mReady);
+		done.push_back(models.back()->mDone);
+	}
+	for (Mesh* mesh : scene.mMeshes) {
+		dependencies.push_back(pool.Add([mesh, arena]() { mesh->BuildAccelerationStructure(*arena); }));
+	}
+
+	ThreadPool* jobs = &pool;
+	return pool.Add([=]() mutable {
+		bool loaded = true;
+		for (size_t ii = 0; ii < models.size(); ++ii) {
+			if (!models[ii]->mModel) {
+				printf("%s:%d: couldn't load model %s\n", path.c_str(), scene.mModels[ii].mLine, scene.mModels[ii].mPath.c_str());
+				loaded = false;
+			}
+		}
+		// The other models may still be writing their scene caches
+		if (!loaded) {
+			jobs->Add([arena]() { delete arena; }, done);
+			return;
+		}
+
+		for (size_t ii = 0; ii < models.size(); ++ii) {
+			models[ii]->mModel->AddMeshes(scene.mObjects, scene.mModels[ii].mTranslation, *arena, scene.mModels[ii].mMaterial);
+		}
+		for (Mesh* mesh : scene.mMeshes) {
+			scene.mObjects.push_back(mesh);
+		}
+		*world = new World(scene.mObjects, scene.mLights, arena);
+	}, dependencies);
+}
+
+// LoadSceneAsync on a pool of its own, returning once the scene is ready. False if it couldn't be loaded
+bool LoadScene(std::string const& path, World** world, Camera** camera, int const width, int const height, bool const hugePages = false) {
+	ThreadPool pool;
+	Job* const ready = LoadSceneAsync(pool, path, world, camera, width, height, hugePages);
+	if (!ready) {
+		return false;
+	}
+	pool.Wait(ready);
+	return *world != nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "util.h"
+
+// Run time settings, given on the command line as --name value or in a config file as name = value lines with
+// # comments. --config path reads a file where it appears, so settings after it override the file's and the
+// file's override the ones before it
+
+// One setting, which parses its value straight into the variable it controls
+struct Setting {
+	char const* mName;
+	char const* mHelp;
+	std::function<bool(char const*)> mSet; // False if the value isn't valid, the variable is left alone then
+	std::function<std::string()> mGet; // The current value and any choices, for --help
+};
+
+enum SettingsResult {
+	kSettingsOk,
+	kSettingsHelp, // --help was given, the settings have been listed
+	kSettingsError, // What's wrong has been printed
+};
+
+inline Setting IntSetting(char const* name, int* value, int const minimum, char const* help) {
+	Setting setting;
+	setting.mName = name;
+	setting.mHelp = help;
+	setting.mSet = [value, minimum](char const* text) {
+		char* end;
+		errno = 0;
+		long const parsed = strtol(text, &end, 10);
+		if (end == text || *end != '\0' || errno != 0 || parsed < minimum || parsed > INT_MAX) {
+			return false;
+		}
+		*value = (int)parsed;
+		return true;
+	};
+	setting.mGet = [value]() { return std::to_string(*value); };
+	return setting;
+}
+
+inline Setting FloatSetting(char const* name, double* value, double const minimum, char const* help) {
+	Setting setting;
+	setting.mName = name;
+	setting.mHelp = help;
+	setting.mSet = [value, minimum](char const* text) {
+		char* end;
+		double const parsed = strtod(text, &end);
+		if (end == text || *end != '\0' || !(parsed >= minimum) || parsed > 1e300) {
+			return false;
+		}
+		*value = parsed;
+		return true;
+	};
+	setting.mGet = [value]() {
+		char text[32];
+		snprintf(text, sizeof(text), "%g", *value);
+		return std::string(text);
+	};
+	return setting;
+}
+
+inline Setting StringSetting(char const* name, std::string* value, char const* help) {
+	Setting setting;
+	setting.mName = name;
+	setting.mHelp = help;
+	setting.mSet = [value](char const* text) {
+		*value = text;
+		return true;
+	};
+	setting.mGet = [value]() { return *value; };
+	return setting;
+}
+
+inline Setting BoolSetting(char const* name, bool* value, char const* help) {
+	Setting setting;
+	setting.mName = name;
+	setting.mHelp = help;
+	setting.mSet = [value](char const* text) {
+		if (strcmp(text, "on") == 0 || strcmp(text, "true") == 0 || strcmp(text, "1") == 0) {
+			*value = true;
+		}
+		else if (strcmp(text, "off") == 0 || strcmp(text, "false") == 0 || strcmp(text, "0") == 0) {
+			*value = false;
+		}
+		else {
+			return false;
+		}
+		return true;
+	};
+	setting.mGet = [value]() { return std::string(*value ? "on" : "off"); };
+	return setting;
+}
+
+// One of names, which are in the order of the enum T
+template <typename T>
+Setting ChoiceSetting(char const* name, T* value, char const* const* names, int const count, char const* help) {
+	Setting setting;
+	setting.mName = name;
+	setting.mHelp = help;
+	setting.mSet = [value, names, count](char const* text) {
+		for (int ii = 0; ii < count; ++ii) {
+			if (strcmp(text, names[ii]) == 0) {
+				*value = (T)ii;
+				return true;
+			}
+		}
+		return false;
+	};
+	setting.mGet = [value, names, count]() {
+		std::string text = names[(int)*value];
+		text += " (";
+		for (int ii = 0; ii < count; ++ii) {
+			text += ii > 0 ? ", " : "";
+			text += names[ii];
+		}
+		return text + ")";
+	};
+	return setting;
+}
+
+// The count comes from the name table, so it can't fall out of step with it
+template <typename T, size_t N>
+Setting ChoiceSetting(char const* name, T* value, char const* const (&names)[N], char const* help) {
+	return ChoiceSetting(name, value, names, (int)N, help);
+}
+
+inline bool ApplySetting(std::vector<Setting> const& settings, std::string const& name, std::string const& value, std::string const& where) {
+	for (Setting const& setting : settings) {
+		if (name == setting.mName) {
+			if (!setting.mSet(value.c_str())) {
+				printf("%s: bad value for %s: %s\n", where.c_str(), name.c_str(), value.c_str());
+				return false;
+			}
+			return true;
+		}
+	}
+	printf("%s: unknown setting %s\n", where.c_str(), name.c_str());
+	return false;
+}
+
+inline std::string TrimSetting(std::string const& text) {
+	size_t const begin = text.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos) {
+		return std::string();
+	}
+	size_t const end = text.find_last_not_of(" \t\r\n");
+	return text.substr(begin, end - begin + 1);
+}
+
+// name = value a line, blank lines and # comments are skipped
+bool LoadSettingsFile(std::vector<Setting> const& settings, char const* path) {
+	FILE* file = OpenFile(path, "r");
+	if (!file) {
+		printf("Couldn't open config file: %s\n", path);
+		return false;
+	}
+
+	bool ok = true;
+	char buffer[1024];
+	std::string line;
+	int lineNumber = 0;
+	while (ok && fgets(buffer, sizeof(buffer), file)) {
+		line += buffer;
+		if (!line.empty() && line.back() != '\n' && !feof(file)) {
+			continue; // Longer than the buffer
+		}
+		++lineNumber;
+
+		std::string const statement = TrimSetting(line.substr(0, line.find('#')));
+		line.clear();
+		if (statement.empty()) {
+			continue;
+		}
+		std::string const where = std::string(path) + ":" + std::to_string(lineNumber);
+		size_t const equals = statement.find('=');
+		if (equals == std::string::npos) {
+			printf("%s: expected name = value\n", where.c_str());
+			ok = false;
+			break;
+		}
+		ok = ApplySetting(settings, TrimSetting(statement.substr(0, equals)), TrimSetting(statement.substr(equals + 1)), where);
+	}
+	fclose(file);
+	return ok;
+}
+
+void PrintSettings(std::vector<Setting> const& settings, char const* program) {
+	printf("Usage: %s [--config path] [--name value ...]\n\n", program);
+	for (Setting const& setting : settings) {
+		printf("  --%-20s %s [%s]\n", setting.mName, setting.mHelp, setting.mGet().c_str());
+	}
+}
+
+SettingsResult ParseSettings(std::vector<Setting> const& settings, int const argc, char** argv) {
+	for (int ii = 1; ii < argc; ++ii) {
+		char const* const arg = argv[ii];
+		if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+			PrintSettings(settings, argv[0]);
+			return kSettingsHelp;
+		}
+		if (strncmp(arg, "--", 2) != 0 || ii + 1 >= argc) {
+			printf("Expected --name value, got %s. --help lists the settings\n", arg);
+			return kSettingsError;
+		}
+		char const* const value = argv[++ii];
+		if (strcmp(arg, "--config") == 0) {
+			if (!LoadSettingsFile(settings, value)) {
+				return kSettingsError;
+			}
+		}
+		else if (!ApplySetting(settings, arg + 2, value, "command line")) {
+			return kSettingsError;
+		}
+	}
+	return kSettingsOk;
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include "util.h"
+
+// Counts of what a render does. Define RAY_STATS to compile them in, otherwise STAT_ADD disappears
+enum StatCounter {
+	kPrimaryRays,
+	kSecondaryRays,
+	kShadowRays,
+	kBoxTests,
+	kTriangleTests,
+	kSphereTests,
+	kBVHNodes,
+	kOctreeNodes,
+	kDepthTerminated,
+	kStatCount,
+};
+
+char const* const kStatNames[kStatCount] = {
+	"primary_rays",
+	"secondary_rays",
+	"shadow_rays",
+	"box_tests",
+	"triangle_tests",
+	"sphere_tests",
+	"bvh_nodes",
+	"octree_nodes",
+	"depth_terminated",
+};
+
+// One per thread, each thread only ever writes its own so no atomics are needed
+struct alignas(64) RayStats {
+	RayStats() : mSeconds(0.0) {
+		for (int ii = 0; ii < kStatCount; ++ii) {
+			mCounts[ii] = 0;
+		}
+	}
+
+	void Add(RayStats const& other) {
+		for (int ii = 0; ii < kStatCount; ++ii) {
+			mCounts[ii] += other.mCounts[ii];
+		}
+		mSeconds += other.mSeconds;
+	}
+
+	uint64_t Rays() const {
+		return mCounts[kPrimaryRays] + mCounts[kSecondaryRays] + mCounts[kShadowRays];
+	}
+
+	uint64_t mCounts[kStatCount];
+	double mSeconds; // Time the thread spent rendering
+};
+
+// Packets count one per lane so the totals match single ray traversal
+inline uint32_t LaneCount(uint32_t mask) {
+	uint32_t count = 0;
+	for (; mask; mask &= mask - 1) {
+		++count;
+	}
+	return count;
+}
+
+#if defined(RAY_STATS)
+thread_local RayStats tRayStats;
+#define STAT_ADD(counter, n) (tRayStats.mCounts[counter] += (n))
+#else
+#define STAT_ADD(counter, n) ((void)0)
+#endif
+
+#define STAT_INC(counter) STAT_ADD(counter, 1)
+
+// Sum the per thread counters and report them, to stdout and as JSON to path
+void ReportRayStats(RayStats const* threadStats, int const threadCount, double const wallSeconds, char const* path) {
+	RayStats total;
+	for (int ii = 0; ii < threadCount; ++ii) {
+		total.Add(threadStats[ii]);
+	}
+	double const mraysPerSecond = wallSeconds > 0.0 ? (double)total.Rays() / wallSeconds * 1e-6 : 0.0;
+
+	printf("%.3f s, %llu rays, %.2f Mrays/s\n", wallSeconds, (unsigned long long)total.Rays(), mraysPerSecond);
+	for (int ii = 0; ii < kStatCount; ++ii) {
+		printf("  %-18s %llu\n", kStatNames[ii], (unsigned long long)total.mCounts[ii]);
+	}
+
+	FILE* file = OpenFile(path, "w");
+	if (!file) {
+		printf("Could not write %s\n", path);
+		return;
+	}
+	fprintf(file, "{\n\t\"wall_seconds\": %.6f,\n\t\"threads\": %d,\n\t\"rays\": %llu,\n\t\"mrays_per_second\": %.4f,\n",
+		wallSeconds, threadCount, (unsigned long long)total.Rays(), mraysPerSecond);
+	fprintf(file, "\t\"counters\": {\n");
+	for (int ii = 0; ii < kStatCount; ++ii) {
+		fprintf(file, "\t\t\"%s\": %llu%s\n", kStatNames[ii], (unsigned long long)total.mCounts[ii], ii + 1 < kStatCount ? "," : "");
+	}
+	fprintf(file, "\t},\n\t\"per_thread\": [\n");
+	for (int ii = 0; ii < threadCount; ++ii) {
+		fprintf(file, "\t\t{ \"seconds\": %.6f, \"rays\": %llu }%s\n",
+			threadStats[ii].mSeconds, (unsigned long long)threadStats[ii].Rays(), ii + 1 < threadCount ? "," : "");
+	}
+	fprintf(file, "\t]\n}\n");
+	fclose(file);
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "PerfCounters.h"
+#include "Trace.h"
+
+// A piece of work on a ThreadPool, which runs once every job it depends on has run
+struct Job {
+	std::function<void()> mWork;
+	int mPending; // Dependencies that haven't run yet, plus one until the job is submitted
+	bool mDone;
+	std::vector<Job*> mDependents;
+};
+
+// Fixed set of worker threads that run a graph of jobs. Jobs only wait on other jobs through dependencies, never
+// by blocking inside their work, so the pool can't deadlock however few threads it has. A job can add new jobs
+// while it runs and make jobs that haven't started yet depend on them
+class ThreadPool {
+public:
+	// threads 0 uses every hardware thread
+	explicit ThreadPool(int threads = 0) : mUnfinished(0), mStopping(false) {
+		if (threads <= 0) {
+			threads = std::max((int)std::thread::hardware_concurrency(), 1);
+		}
+		for (int ii = 0; ii < threads; ++ii) {
+			mWorkers.push_back(std::thread(&ThreadPool::Work, this, ii));
+		}
+	}
+
+	// Runs every job that's left before the threads stop
+	~ThreadPool() {
+		WaitAll();
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mStopping = true;
+		}
+		mReady.notify_all();
+		for (std::thread& worker : mWorkers) {
+			worker.join();
+		}
+	}
+
+	ThreadPool(ThreadPool const&) = delete;
+	ThreadPool& operator=(ThreadPool const&) = delete;
+
+	// Queue work to run after dependencies, which may include nullptr for nothing. The job lives as long as the pool
+	Job* Add(std::function<void()> work, std::initializer_list<Job*> dependencies = {}) {
+		return Add(std::move(work), std::vector<Job*>(dependencies));
+	}
+
+	Job* Add(std::function<void()> work, std::vector<Job*> const& dependencies) {
+		Job* job = Prepare(std::move(work), dependencies);
+		Submit(job);
+		return job;
+	}
+
+	// A job that won't run until it's given to Submit, so dependencies can still be added to it once other jobs that
+	// need to know about it have been made
+	Job* Prepare(std::function<void()> work, std::vector<Job*> const& dependencies = std::vector<Job*>()) {
+		std::lock_guard<std::mutex> lock(mLock);
+		mJobs.push_back(std::unique_ptr<Job>(new Job()));
+		Job* job = mJobs.back().get();
+		job->mWork = std::move(work);
+		job->mPending = 1;
+		job->mDone = false;
+		++mUnfinished;
+		for (Job* dependency : dependencies) {
+			AddDependencyLocked(job, dependency);
+		}
+		return job;
+	}
+
+	void Submit(Job* job) {
+		std::lock_guard<std::mutex> lock(mLock);
+		Release(job);
+	}
+
+	// Make job wait for dependency as well. Only for jobs that can't have started, like prepared ones or ones that
+	// depend on the job calling this
+	void AddDependency(Job* job, Job* dependency) {
+		std::lock_guard<std::mutex> lock(mLock);
+		AddDependencyLocked(job, dependency);
+	}
+
+	// Block until job has run. Not from inside a job, that's what dependencies are for
+	void Wait(Job const* job) {
+		std::unique_lock<std::mutex> lock(mLock);
+		mIdle.wait(lock, [job]() { return job->mDone; });
+	}
+
+	// Block until every job added so far, and every job they add, has run
+	void WaitAll() {
+		std::unique_lock<std::mutex> lock(mLock);
+		mIdle.wait(lock, [this]() { return mUnfinished == 0; });
+	}
+
+	int ThreadCount() const { return (int)mWorkers.size(); }
+
+private:
+	// Needs mLock
+	void AddDependencyLocked(Job* job, Job* dependency) {
+		if (dependency && !dependency->mDone) {
+			dependency->mDependents.push_back(job);
+			++job->mPending;
+		}
+	}
+
+	// One of job's dependencies has run, it's queued when the last one has. Needs mLock
+	void Release(Job* job) {
+		if (--job->mPending == 0) {
+			mQueue.push_back(job);
+			mReady.notify_one();
+		}
+	}
+
+	void Work(int const number) {
+		SetTraceThreadName("Worker", number);
+		SetPerfThreadName("Worker", number);
+		std::unique_lock<std::mutex> lock(mLock);
+		while (true) {
+			mReady.wait(lock, [this]() { return mStopping || !mQueue.empty(); });
+			if (mQueue.empty()) {
+				return;
+			}
+			Job* job = mQueue.front();
+			mQueue.pop_front();
+
+			lock.unlock();
+			job->mWork();
+			job->mWork = nullptr; // Free what it captured
+			lock.lock();
+
+			job->mDone = true;
+			for (Job* dependent : job->mDependents) {
+				Release(dependent);
+			}
+			job->mDependents.clear();
+			--mUnfinished;
+			mIdle.notify_all();
+		}
+	}
+
+	std::vector<std::thread> mWorkers;
+	std::vector<std::unique_ptr<Job>> mJobs;
+	std::deque<Job*> mQueue; // Jobs that can run, oldest first
+	size_t mUnfinished; // Jobs added that haven't run
+	bool mStopping;
+	std::mutex mLock;
+	std::condition_variable mReady; // Something was queued, or the pool is stopping
+	std::condition_variable mIdle; // A job finished
+};
\ No newline at end of file
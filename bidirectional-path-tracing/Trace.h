@@ -0,0 +1,168 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "util.h"
+
+// Timeline of what each thread was doing, written as Chrome trace JSON for chrome://tracing or Perfetto.
+// Off unless StartTrace is called, then every TRACE_SCOPE records one complete event
+
+// Events kept per thread, the oldest are overwritten once it fills
+int const kTraceBufferSize = 1 << 14;
+
+// Names must be string literals, only the pointer is kept
+struct TraceEvent {
+	char const* mName;
+	char const* mArgNames[2];
+	int mArgs[2];
+	uint64_t mStart; // Nanoseconds since StartTrace
+	uint64_t mDuration;
+};
+
+// Ring of events written only by the thread that owns it
+class TraceBuffer {
+public:
+	TraceBuffer(int const threadId) : mThreadId(threadId), mCount(0) {}
+
+	// Grows to kTraceBufferSize, so short lived threads stay small
+	void Add(TraceEvent const& e) {
+		if (mEvents.size() < (size_t)kTraceBufferSize) {
+			mEvents.push_back(e);
+		} else {
+			mEvents[mCount % kTraceBufferSize] = e;
+		}
+		++mCount;
+	}
+
+	int mThreadId;
+	std::string mThreadName;
+	uint64_t mCount; // Ever added, more than kTraceBufferSize means some were dropped
+	std::vector<TraceEvent> mEvents;
+};
+
+// Buffers outlive their threads so they can be written at exit
+struct TraceState {
+	TraceState() : mEnabled(false), mPath(nullptr) {}
+
+	bool mEnabled;
+	char const* mPath;
+	std::chrono::steady_clock::time_point mEpoch;
+	std::mutex mLock; // Only taken when a thread makes its buffer
+	std::vector<TraceBuffer*> mBuffers;
+};
+
+TraceState gTrace;
+thread_local TraceBuffer* tTraceBuffer = nullptr;
+
+inline bool TraceEnabled() {
+	return gTrace.mEnabled;
+}
+
+inline uint64_t TraceNow() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - gTrace.mEpoch).count();
+}
+
+TraceBuffer* GetTraceBuffer() {
+	if (!tTraceBuffer) {
+		std::lock_guard<std::mutex> lock(gTrace.mLock);
+		tTraceBuffer = new TraceBuffer((int)gTrace.mBuffers.size());
+		gTrace.mBuffers.push_back(tTraceBuffer);
+	}
+	return tTraceBuffer;
+}
+
+// Label for this thread's row in the viewer, number is appended if it isn't negative
+void SetTraceThreadName(char const* name, int const number = -1) {
+	if (TraceEnabled()) {
+		std::string& threadName = GetTraceBuffer()->mThreadName;
+		threadName = name;
+		if (number >= 0) {
+			threadName += " " + std::to_string(number);
+		}
+	}
+}
+
+// Times the enclosing scope
+class TraceScope {
+public:
+	TraceScope(char const* name, char const* argName0 = nullptr, int const arg0 = 0, char const* argName1 = nullptr, int const arg1 = 0) : mEnabled(TraceEnabled()) {
+		if (!mEnabled) {
+			return;
+		}
+		mEvent.mName = name;
+		mEvent.mArgNames[0] = argName0;
+		mEvent.mArgNames[1] = argName1;
+		mEvent.mArgs[0] = arg0;
+		mEvent.mArgs[1] = arg1;
+		mEvent.mStart = TraceNow();
+	}
+
+	~TraceScope() {
+		if (mEnabled) {
+			mEvent.mDuration = TraceNow() - mEvent.mStart;
+			GetTraceBuffer()->Add(mEvent);
+		}
+	}
+
+private:
+	bool const mEnabled;
+	TraceEvent mEvent;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(...) TraceScope TRACE_CONCAT(traceScope, __LINE__)(__VA_ARGS__)
+
+// Write every buffer as Chrome trace JSON. Call once the traced threads have finished
+void WriteTrace() {
+	if (!gTrace.mEnabled) {
+		return;
+	}
+	gTrace.mEnabled = false;
+
+	FILE* file = OpenFile(gTrace.mPath, "w");
+	if (!file) {
+		printf("Could not write %s\n", gTrace.mPath);
+		return;
+	}
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (TraceBuffer const* buffer : gTrace.mBuffers) {
+		if (!buffer->mThreadName.empty()) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", buffer->mThreadId, buffer->mThreadName.c_str());
+			first = false;
+		}
+
+		uint64_t const begin = buffer->mCount > (uint64_t)kTraceBufferSize ? buffer->mCount - kTraceBufferSize : 0;
+		if (begin > 0) {
+			printf("Trace dropped the first %llu events of thread %d\n", (unsigned long long)begin, buffer->mThreadId);
+		}
+		for (uint64_t ii = begin; ii < buffer->mCount; ++ii) {
+			TraceEvent const& e = buffer->mEvents[ii % kTraceBufferSize];
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{",
+				first ? "" : ",\n", e.mName, buffer->mThreadId, (double)e.mStart * 1e-3, (double)e.mDuration * 1e-3);
+			for (int arg = 0; arg < 2 && e.mArgNames[arg]; ++arg) {
+				fprintf(file, "%s\"%s\":%d", arg > 0 ? "," : "", e.mArgNames[arg], e.mArgs[arg]);
+			}
+			fprintf(file, "}}");
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	printf("Wrote trace to %s\n", gTrace.mPath);
+}
+
+// Start recording, the trace is written to path when the program exits. Call before starting any threads
+void StartTrace(char const* path) {
+	gTrace.mPath = path;
+	gTrace.mEpoch = std::chrono::steady_clock::now();
+	gTrace.mEnabled = true;
+	atexit(WriteTrace);
+}
\ No newline at end of file
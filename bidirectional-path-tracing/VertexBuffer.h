@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "vec2.h"
+#include "vec3.h"
+
+enum VertexAttribute {
+	kPosX,
+	kPosY,
+	kPosZ,
+	kNormX,
+	kNormY,
+	kNormZ,
+	kTexU,
+	kTexV,
+	kVertexAttributeCount,
+};
+
+// Vertex attributes of a mesh as one array per component, shared by every triangle that indexes them. The arrays
+// are either filled with Add or belong to someone else, like a mapped scene cache
+class VertexBuffer {
+public:
+	VertexBuffer() : mSize(0) {
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			mAttributes[attribute] = nullptr;
+		}
+	}
+
+	VertexBuffer(VertexBuffer const&) = delete;
+	VertexBuffer& operator=(VertexBuffer const&) = delete;
+
+	void Reserve(size_t const count) {
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			mStorage[attribute].reserve(count);
+			mAttributes[attribute] = mStorage[attribute].data();
+		}
+	}
+
+	uint32_t Add(Vec3 const& pos, Vec3 const& norm, Vec2 const& texCoords) {
+		float const values[kVertexAttributeCount] = { pos.x(), pos.y(), pos.z(), norm.x(), norm.y(), norm.z(), texCoords.x(), texCoords.y() };
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			mStorage[attribute].push_back(values[attribute]);
+			mAttributes[attribute] = mStorage[attribute].data();
+		}
+		return (uint32_t)(mSize++);
+	}
+
+	// Use arrays owned elsewhere, which must outlive the buffer
+	void View(float* const* attributes, size_t const count) {
+		for (int attribute = 0; attribute < kVertexAttributeCount; ++attribute) {
+			mStorage[attribute].clear();
+			mStorage[attribute].shrink_to_fit();
+			mAttributes[attribute] = attributes[attribute];
+		}
+		mSize = count;
+	}
+
+	size_t Size() const { return mSize; }
+	float const* Attribute(VertexAttribute const attribute) const { return mAttributes[attribute]; }
+
+	Vec3 Position(uint32_t const ii) const { return Vec3(mAttributes[kPosX][ii], mAttributes[kPosY][ii], mAttributes[kPosZ][ii]); }
+	Vec3 Normal(uint32_t const ii) const { return Vec3(mAttributes[kNormX][ii], mAttributes[kNormY][ii], mAttributes[kNormZ][ii]); }
+	Vec2 TexCoords(uint32_t const ii) const { return Vec2(mAttributes[kTexU][ii], mAttributes[kTexV][ii]); }
+
+private:
+	float* mAttributes[kVertexAttributeCount];
+	std::vector<float> mStorage[kVertexAttributeCount];
+	size_t mSize;
+};
\ No newline at end of file
@@ -0,0 +1,317 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include "vec2.h"
+#include "vec3.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Deterministic maps from the unit square to common domains, all without rejection so every sample has
+// a fixed cost. Directions are in a local frame with z as the pole.
+
+inline Vec2 SquareToConcentricDisk(Vec2 const& u) {
+	float const a = 2.f * u.x() - 1.f;
+	float const b = 2.f * u.y() - 1.f;
+	if (a == 0.f && b == 0.f) {
+		return Vec2(0.f, 0.f);
+	}
+
+	// Map squares to rings so strata stay compact (Shirley and Chiu)
+	float r, phi;
+	if (fabs(a) > fabs(b)) {
+		r = a;
+		phi = (float)(M_PI / 4.0) * (b / a);
+	} else {
+		r = b;
+		phi = (float)(M_PI / 2.0) - (float)(M_PI / 4.0) * (a / b);
+	}
+	return Vec2(r * cos(phi), r * sin(phi));
+}
+
+inline float ConcentricDiskPdf() {
+	return (float)(1.0 / M_PI);
+}
+
+inline Vec3 SquareToUniformHemisphere(Vec2 const& u) {
+	float const z = u.x();
+	float const r = sqrt(fmax(0.f, 1.f - z * z));
+	float const phi = (float)(2.0 * M_PI) * u.y();
+	return Vec3(r * cos(phi), r * sin(phi), z);
+}
+
+inline float UniformHemispherePdf() {
+	return (float)(1.0 / (2.0 * M_PI));
+}
+
+// Project the concentric disk up onto the hemisphere (Malley's method). z comes from the disk radius rather than
+// the rounded point, near the rim the square root would magnify that rounding
+inline Vec3 SquareToCosineHemisphere(Vec2 const& u) {
+	Vec2 const d = SquareToConcentricDisk(u);
+	float const r = fmax(fabs(2.f * u.x() - 1.f), fabs(2.f * u.y() - 1.f));
+	float const z = sqrt(fmax(0.f, (1.f - r) * (1.f + r)));
+	return Vec3(d.x(), d.y(), z);
+}
+
+inline float CosineHemispherePdf(float const cosTheta) {
+	return cosTheta * (float)(1.0 / M_PI);
+}
+
+inline Vec3 SquareToUniformSphere(Vec2 const& u) {
+	float const z = 1.f - 2.f * u.x();
+	float const r = sqrt(fmax(0.f, 1.f - z * z));
+	float const phi = (float)(2.0 * M_PI) * u.y();
+	return Vec3(r * cos(phi), r * sin(phi), z);
+}
+
+inline float UniformSpherePdf() {
+	return (float)(1.0 / (4.0 * M_PI));
+}
+
+// Uniform over the directions within acos(cosThetaMax) of the pole
+inline Vec3 SquareToSphericalCap(Vec2 const& u, float const cosThetaMax) {
+	float const z = 1.f - u.x() * (1.f - cosThetaMax);
+	float const r = sqrt(fmax(0.f, 1.f - z * z));
+	float const phi = (float)(2.0 * M_PI) * u.y();
+	return Vec3(r * cos(phi), r * sin(phi), z);
+}
+
+inline float SphericalCapPdf(float const cosThetaMax) {
+	return 1.f / ((float)(2.0 * M_PI) * (1.f - cosThetaMax));
+}
+
+// Barycentric weights of the second and third vertices, uniform by area
+inline Vec2 SquareToTriangle(Vec2 const& u) {
+	float const s = sqrt(u.x());
+	return Vec2(u.y() * s, 1.f - s);
+}
+
+// Total area of the faces SquareToBoxSurface picks from
+inline float BoxSurfaceArea(Vec3 const& size, float const faceSide[3]) {
+	return (faceSide[0] != 0.f ? size.y() * size.z() : 0.f)
+		+ (faceSide[1] != 0.f ? size.z() * size.x() : 0.f)
+		+ (faceSide[2] != 0.f ? size.x() * size.y() : 0.f);
+}
+
+// Uniform by area over one face per axis of a box spanning [0, size], faceSide picks the max face (1),
+// the min face (-1) or neither (0) on each axis. Sets the outward normal of the face picked
+inline Vec3 SquareToBoxSurface(Vec2 const& u, Vec3 const& size, float const faceSide[3], Vec3& normal) {
+	float const faceArea[3] = {
+		faceSide[0] != 0.f ? size.y() * size.z() : 0.f,
+		faceSide[1] != 0.f ? size.z() * size.x() : 0.f,
+		faceSide[2] != 0.f ? size.x() * size.y() : 0.f,
+	};
+
+	// Choose a face proportional to its area and stretch the remainder of u.x() over it
+	float select = u.x() * (faceArea[0] + faceArea[1] + faceArea[2]);
+	int axis = 0;
+	for (int ii = 0; ii < 3; ++ii) {
+		if (faceArea[ii] <= 0.f) {
+			continue;
+		}
+		axis = ii;
+		if (select < faceArea[ii]) {
+			break;
+		}
+		select -= faceArea[ii];
+	}
+	float const faceU = faceArea[axis] > 0.f ? fmin(fmax(select / faceArea[axis], 0.f), 1.f) : 0.f;
+
+	int const axisU = (axis + 1) % 3;
+	int const axisV = (axis + 2) % 3;
+	Vec3 p;
+	p[axis] = faceSide[axis] > 0.f ? size[axis] : 0.f;
+	p[axisU] = faceU * size[axisU];
+	p[axisV] = u.y() * size[axisV];
+
+	normal = Vec3(0, 0, 0);
+	normal[axis] = faceSide[axis] > 0.f ? 1.f : -1.f;
+	return p;
+}
+
+// Batched versions map 8 samples at once in structure of arrays form for wavefront loops. They give the
+// same results as the scalar versions up to float rounding.
+int const kWarpBatchSize = 8;
+
+#if defined(__AVX2__)
+
+inline __m256 MulAdd8(__m256 const a, __m256 const b, __m256 const c) {
+#if defined(__FMA__)
+	return _mm256_fmadd_ps(a, b, c);
+#else
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+
+// sin(x) for |x| <= pi, folded onto [-pi/2, pi/2] where the Taylor series to x^11 is exact to float
+inline __m256 Sin8(__m256 const x) {
+	__m256 const signMask = _mm256_set1_ps(-0.f);
+	__m256 const sign = _mm256_and_ps(x, signMask);
+	__m256 a = _mm256_andnot_ps(signMask, x);
+	a = _mm256_min_ps(a, _mm256_sub_ps(_mm256_set1_ps((float)M_PI), a));
+	a = _mm256_or_ps(a, sign);
+
+	__m256 const a2 = _mm256_mul_ps(a, a);
+	__m256 p = _mm256_set1_ps(-2.5052108e-8f);
+	p = MulAdd8(p, a2, _mm256_set1_ps(2.7557319e-6f));
+	p = MulAdd8(p, a2, _mm256_set1_ps(-1.9841270e-4f));
+	p = MulAdd8(p, a2, _mm256_set1_ps(8.3333333e-3f));
+	p = MulAdd8(p, a2, _mm256_set1_ps(-1.6666667e-1f));
+	p = MulAdd8(p, a2, _mm256_set1_ps(1.f));
+	return _mm256_mul_ps(p, a);
+}
+
+// cos(x) = sin(pi/2 - |x|) for |x| <= pi
+inline __m256 Cos8(__m256 const x) {
+	__m256 const a = _mm256_andnot_ps(_mm256_set1_ps(-0.f), x);
+	return Sin8(_mm256_sub_ps(_mm256_set1_ps((float)(M_PI / 2.0)), a));
+}
+
+// Unit circle at 2 pi u, computed as the negation of the angle shifted into [-pi, pi)
+inline void UnitCircle8(__m256 const u, __m256& x, __m256& y) {
+	__m256 const phi = MulAdd8(u, _mm256_set1_ps((float)(2.0 * M_PI)), _mm256_set1_ps((float)-M_PI));
+	__m256 const signMask = _mm256_set1_ps(-0.f);
+	x = _mm256_xor_ps(Cos8(phi), signMask);
+	y = _mm256_xor_ps(Sin8(phi), signMask);
+}
+
+inline __m256 SqrtClamped8(__m256 const v) {
+	return _mm256_sqrt_ps(_mm256_max_ps(v, _mm256_setzero_ps()));
+}
+
+inline void SquareToConcentricDisk8(float const* u0, float const* u1, float* x, float* y) {
+	__m256 const one = _mm256_set1_ps(1.f);
+	__m256 const two = _mm256_set1_ps(2.f);
+	__m256 const a = _mm256_sub_ps(_mm256_mul_ps(two, _mm256_loadu_ps(u0)), one);
+	__m256 const b = _mm256_sub_ps(_mm256_mul_ps(two, _mm256_loadu_ps(u1)), one);
+
+	__m256 const signMask = _mm256_set1_ps(-0.f);
+	__m256 const useA = _mm256_cmp_ps(_mm256_andnot_ps(signMask, a), _mm256_andnot_ps(signMask, b), _CMP_GT_OQ);
+	__m256 const quarterPi = _mm256_set1_ps((float)(M_PI / 4.0));
+
+	// Both branches are computed and blended, the origin divides by zero and is masked off below
+	__m256 const phiA = _mm256_mul_ps(quarterPi, _mm256_div_ps(b, a));
+	__m256 const phiB = _mm256_sub_ps(_mm256_set1_ps((float)(M_PI / 2.0)), _mm256_mul_ps(quarterPi, _mm256_div_ps(a, b)));
+	__m256 const r = _mm256_blendv_ps(b, a, useA);
+	__m256 phi = _mm256_blendv_ps(phiB, phiA, useA);
+
+	__m256 const zero = _mm256_setzero_ps();
+	__m256 const origin = _mm256_and_ps(_mm256_cmp_ps(a, zero, _CMP_EQ_OQ), _mm256_cmp_ps(b, zero, _CMP_EQ_OQ));
+	phi = _mm256_blendv_ps(phi, zero, origin);
+
+	_mm256_storeu_ps(x, _mm256_blendv_ps(_mm256_mul_ps(r, Cos8(phi)), zero, origin));
+	_mm256_storeu_ps(y, _mm256_blendv_ps(_mm256_mul_ps(r, Sin8(phi)), zero, origin));
+}
+
+inline void SquareToUniformHemisphere8(float const* u0, float const* u1, float* x, float* y, float* z) {
+	__m256 const cosTheta = _mm256_loadu_ps(u0);
+	__m256 const r = SqrtClamped8(_mm256_sub_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(cosTheta, cosTheta)));
+	__m256 cx, cy;
+	UnitCircle8(_mm256_loadu_ps(u1), cx, cy);
+	_mm256_storeu_ps(x, _mm256_mul_ps(r, cx));
+	_mm256_storeu_ps(y, _mm256_mul_ps(r, cy));
+	_mm256_storeu_ps(z, cosTheta);
+}
+
+inline void SquareToCosineHemisphere8(float const* u0, float const* u1, float* x, float* y, float* z) {
+	SquareToConcentricDisk8(u0, u1, x, y);
+	__m256 const one = _mm256_set1_ps(1.f);
+	__m256 const two = _mm256_set1_ps(2.f);
+	__m256 const signMask = _mm256_set1_ps(-0.f);
+	__m256 const a = _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_mul_ps(two, _mm256_loadu_ps(u0)), one));
+	__m256 const b = _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_mul_ps(two, _mm256_loadu_ps(u1)), one));
+	__m256 const r = _mm256_max_ps(a, b);
+	_mm256_storeu_ps(z, SqrtClamped8(_mm256_mul_ps(_mm256_sub_ps(one, r), _mm256_add_ps(one, r))));
+}
+
+inline void SquareToSphericalCap8(float const* u0, float const* u1, float const* cosThetaMax, float* x, float* y, float* z) {
+	__m256 const one = _mm256_set1_ps(1.f);
+	__m256 const cosTheta = _mm256_sub_ps(one, _mm256_mul_ps(_mm256_loadu_ps(u0), _mm256_sub_ps(one, _mm256_loadu_ps(cosThetaMax))));
+	__m256 const r = SqrtClamped8(_mm256_sub_ps(one, _mm256_mul_ps(cosTheta, cosTheta)));
+	__m256 cx, cy;
+	UnitCircle8(_mm256_loadu_ps(u1), cx, cy);
+	_mm256_storeu_ps(x, _mm256_mul_ps(r, cx));
+	_mm256_storeu_ps(y, _mm256_mul_ps(r, cy));
+	_mm256_storeu_ps(z, cosTheta);
+}
+
+inline void SquareToUniformSphere8(float const* u0, float const* u1, float* x, float* y, float* z) {
+	float const minusOne[kWarpBatchSize] = { -1.f, -1.f, -1.f, -1.f, -1.f, -1.f, -1.f, -1.f };
+	SquareToSphericalCap8(u0, u1, minusOne, x, y, z);
+}
+
+inline void SquareToTriangle8(float const* u0, float const* u1, float* b1, float* b2) {
+	__m256 const s = _mm256_sqrt_ps(_mm256_loadu_ps(u0));
+	_mm256_storeu_ps(b1, _mm256_mul_ps(_mm256_loadu_ps(u1), s));
+	_mm256_storeu_ps(b2, _mm256_sub_ps(_mm256_set1_ps(1.f), s));
+}
+
+#else
+
+inline void SquareToConcentricDisk8(float const* u0, float const* u1, float* x, float* y) {
+	for (int ii = 0; ii < kWarpBatchSize; ++ii) {
+		Vec2 const d = SquareToConcentricDisk(Vec2(u0[ii], u1[ii]));
+		x[ii] = d.x();
+		y[ii] = d.y();
+	}
+}
+
+inline void SquareToUniformHemisphere8(float const* u0, float const* u1, float* x, float* y, float* z) {
+	for (int ii = 0; ii < kWarpBatchSize; ++ii) {
+		Vec3 const d = SquareToUniformHemisphere(Vec2(u0[ii], u1[ii]));
+		x[ii] = d.x();
+		y[ii] = d.y();
+		z[ii] = d.z();
+	}
+}
+
+inline void SquareToCosineHemisphere8(float const* u0, float const* u1, float* x, float* y, float* z) {
+	for (int ii = 0; ii < kWarpBatchSize; ++ii) {
+		Vec3 const d = SquareToCosineHemisphere(Vec2(u0[ii], u1[ii]));
+		x[ii] = d.x();
+		y[ii] = d.y();
+		z[ii] = d.z();
+	}
+}
+
+inline void SquareToSphericalCap8(float const* u0, float const* u1, float const* cosThetaMax, float* x, float* y, float* z) {
+	for (int ii = 0; ii < kWarpBatchSize; ++ii) {
+		Vec3 const d = SquareToSphericalCap(Vec2(u0[ii], u1[ii]), cosThetaMax[ii]);
+		x[ii] = d.x();
+		y[ii] = d.y();
+		z[ii] = d.z();
+	}
+}
+
+inline void SquareToUniformSphere8(float const* u0, float const* u1, float* x, float* y, float* z) {
+	for (int ii = 0; ii < kWarpBatchSize; ++ii) {
+		Vec3 const d = SquareToUniformSphere(Vec2(u0[ii], u1[ii]));
+		x[ii] = d.x();
+		y[ii] = d.y();
+		z[ii] = d.z();
+	}
+}
+
+inline void SquareToTriangle8(float const* u0, float const* u1, float* b1, float* b2) {
+	for (int ii = 0; ii < kWarpBatchSize; ++ii) {
+		Vec2 const b = SquareToTriangle(Vec2(u0[ii], u1[ii]));
+		b1[ii] = b.x();
+		b2[ii] = b.y();
+	}
+}
+
+#endif
+
+// Face selection is data dependent, so this stays a scalar loop on every ISA
+inline void SquareToBoxSurface8(float const* u0, float const* u1, Vec3 const& size, float const* faceSide, float* x, float* y, float* z, int* axis) {
+	for (int ii = 0; ii < kWarpBatchSize; ++ii) {
+		Vec3 normal;
+		Vec3 const p = SquareToBoxSurface(Vec2(u0[ii], u1[ii]), size, faceSide + 3 * ii, normal);
+		x[ii] = p.x();
+		y[ii] = p.y();
+		z[ii] = p.z();
+		axis[ii] = normal.x() != 0.f ? 0 : (normal.y() != 0.f ? 1 : 2);
+	}
+}
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "Light.h"
 #include "Octree.h"
+#include "Trace.h"
+#include "PerfCounters.h"
 
 class World {
 public:
@@ -9,23 +11,37 @@ public:
 		mOctree = nullptr;
 		mLights = nullptr;
 		mLightCount = 0;
+		mArena = nullptr;
 	}
 
-	World(std::vector<Object*> objects, std::vector<Light*> lights) {
+	// Takes arena, which the objects and lights should already be in, and frees it along with the world
+	World(std::vector<Object*> objects, std::vector<Light*> lights, Arena* arena) : mArena(arena) {
 		// Add all lights to the object list
 		for (Light* l : lights) {
 			objects.push_back((Object*)l);
 		}
 
-		mOctree = new Octree(objects, 0);
+		{
+			TRACE_SCOPE("Octree build", "objects", (int)objects.size());
+			PERF_PHASE(kPerfBuild);
+			mOctree = arena->New<Octree>(objects, 0, *arena);
+		}
 		mLightCount = lights.size();
-		mLights = new Light*[mLightCount];
+		mLights = arena->NewArray<Light*>(mLightCount);
 		for (int ii = 0; ii < mLightCount; ++ii) {
 			mLights[ii] = lights[ii];
 		}
 	}
 
+	~World() {
+		delete mArena;
+	}
+
+	World(World const&) = delete;
+	World& operator=(World const&) = delete;
+
 	Octree* mOctree;
 	Light** mLights;
 	int mLightCount;
+	Arena* mArena;
 };
\ No newline at end of file
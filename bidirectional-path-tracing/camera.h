@@ -4,6 +4,8 @@
 #include <math.h>
 #include "util.h"
 #include "ray.h"
+#include "vec2.h"
+#include "Warp.h"
 
 class Camera {
 public:
@@ -24,9 +26,10 @@ public:
 		vertical = 2 * halfHeight * focus_dist * v;
 	}
 
-	Ray get_ray(float const s, float const t) {
-		Vec3 randomDisk = lens_radius * RandInDisk();
-		Vec3 offset = u * randomDisk.x() + v * randomDisk.y();
+	// lens is uniform in [0,1)^2 and picks the point on the aperture
+	Ray get_ray(float const s, float const t, Vec2 const& lens) {
+		Vec2 const disk = SquareToConcentricDisk(lens);
+		Vec3 offset = u * (lens_radius * disk.x()) + v * (lens_radius * disk.y());
 		return Ray(origin + offset, lower_left_corner + s * horizontal + t * vertical - origin - offset);
 	}
 
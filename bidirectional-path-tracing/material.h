@@ -1,42 +1,211 @@
 #pragma once
 
 #include "vec3.h"
-#include "Util.h"
+#include "util.h"
+#include "vec2.h"
+#include "Warp.h"
+
+class Light;
+
+struct BsdfSample {
+	Vec3 wi;
+	Vec3 f;
+	float pdf;
+	bool isDelta; // f and pdf are both relative to a delta distribution
+};
+
+// Tag for each concrete material, dispatched on with a switch instead of virtual calls or RTTI
+enum MaterialType : uint8_t {
+	kSolidMaterial,
+	kFlatColorMaterial,
+	kEmissiveMaterial,
+	kMetalMaterial,
+	kDielectricMaterial,
+	kMaterialTypeCount,
+};
 
 class Material {
 public:
-	virtual bool scatter(Ray const& r_in, HitRecord const& rec, float& scatterAmount, Ray& scattered) const = 0;
+	Material(MaterialType const type) : mType(type) {}
+
+	// BSDF for light arriving along wi and leaving along wo, both unit and pointing away from the surface
+	Vec3 Eval(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const;
+
+	// Pick wi for the outgoing direction wo from u in [0,1)^2, false if the path ends here
+	bool Sample(Vec3 const& wo, HitRecord const& rec, Vec2 const& u, BsdfSample& s) const;
+
+	// Density Sample() picks wi with, 0 if it can only come from a delta lobe
+	float Pdf(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const;
+
+	MaterialType const mType;
+};
+
+// Normalized Phong or GGX specular lobe around the mirror direction
+class Glossy {
+public:
+	enum Model {
+		kPhong,
+		kGGX,
+	};
+
+	Glossy() {}
+	Glossy(Model const m, float const shin) : mModel(m), mShinyness(shin), mAlpha(sqrt(2.f / (shin + 2.f))) {}
+
+	// Value without the Fresnel term, normal is already facing wo
+	float Eval(Vec3 const& wi, Vec3 const& wo, Vec3 const& normal) const {
+		float const cosI = dot(wi, normal);
+		float const cosO = dot(wo, normal);
+		if (cosI <= 0.f || cosO <= 0.f) {
+			return 0.f;
+		}
+
+		if (mModel == kPhong) {
+			float const cosAlpha = fmax(0.f, dot(Reflect(-1 * wi, normal), wo));
+			return (mShinyness + 2.f) / (2.f * M_PI) * pow(cosAlpha, mShinyness);
+		}
+
+		Vec3 const half = (wi + wo).unitVec();
+		return D(dot(half, normal)) * G1(cosI) * G1(cosO) / (4.f * cosI * cosO);
+	}
+
+	Vec3 Sample(Vec3 const& wo, Vec3 const& normal, Vec2 const& u) const {
+		Vec3 tangent, bitangent;
+		if (mModel == kPhong) {
+			// Power cosine lobe around the reflected direction
+			Vec3 const reflected = Reflect(-1 * wo, normal);
+			CoordinateSystem(reflected, tangent, bitangent);
+			float const cosAlpha = pow(u.x(), 1.f / (mShinyness + 1.f));
+			float const sinAlpha = sqrt(fmax(0.f, 1.f - cosAlpha * cosAlpha));
+			float const phi = 2.f * M_PI * u.y();
+			return sinAlpha * cos(phi) * tangent + sinAlpha * sin(phi) * bitangent + cosAlpha * reflected;
+		}
+
+		// Microfacet normal from D(h) cos(h), then mirror wo about it
+		CoordinateSystem(normal, tangent, bitangent);
+		float const tanSquared = mAlpha * mAlpha * u.x() / fmax(1e-6f, 1.f - u.x());
+		float const cosTheta = 1.f / sqrt(1.f + tanSquared);
+		float const sinTheta = sqrt(fmax(0.f, 1.f - cosTheta * cosTheta));
+		float const phi = 2.f * M_PI * u.y();
+		Vec3 const half = sinTheta * cos(phi) * tangent + sinTheta * sin(phi) * bitangent + cosTheta * normal;
+		return Reflect(-1 * wo, half);
+	}
+
+	float Pdf(Vec3 const& wi, Vec3 const& wo, Vec3 const& normal) const {
+		if (dot(wi, normal) <= 0.f) {
+			return 0.f;
+		}
+
+		if (mModel == kPhong) {
+			float const cosAlpha = fmax(0.f, dot(Reflect(-1 * wo, normal), wi));
+			return (mShinyness + 1.f) / (2.f * M_PI) * pow(cosAlpha, mShinyness);
+		}
+
+		Vec3 const half = (wi + wo).unitVec();
+		float const cosHalf = dot(half, normal);
+		return D(cosHalf) * cosHalf / (4.f * fabs(dot(wo, half)));
+	}
+
+	// GGX distribution of microfacet normals
+	float D(float const cosHalf) const {
+		if (cosHalf <= 0.f) {
+			return 0.f;
+		}
+		float const alphaSquared = mAlpha * mAlpha;
+		float const denom = cosHalf * cosHalf * (alphaSquared - 1.f) + 1.f;
+		return alphaSquared / (M_PI * denom * denom);
+	}
+
+	// Smith masking for one direction
+	float G1(float const cosTheta) const {
+		float const tanSquared = fmax(0.f, 1.f - cosTheta * cosTheta) / (cosTheta * cosTheta);
+		return 2.f / (1.f + sqrt(1.f + mAlpha * mAlpha * tanSquared));
+	}
+
+	Model mModel;
+	float mShinyness;
+	float mAlpha; // GGX roughness matching the Phong exponent
 };
 
 class Solid : public Material {
 public:
 
-	Solid(Vec3 const& dif, Vec3 const& spec, float const shin) : mDiffuse(dif), mSpecular(spec), mShinyness(shin) {}
+	Solid(Vec3 const& dif, Vec3 const& spec, float const shin, Glossy::Model const model = Glossy::kPhong) : Material(kSolidMaterial), mDiffuse(dif), mSpecular(spec), mShinyness(shin), mLobe(model, shin) {
+		// Choose between the lobes by how much each reflects
+		float const diffuseWeight = mDiffuse.x() + mDiffuse.y() + mDiffuse.z();
+		float const specularWeight = mSpecular.x() + mSpecular.y() + mSpecular.z();
+		mSpecularProb = diffuseWeight + specularWeight > 0.f ? specularWeight / (diffuseWeight + specularWeight) : 0.f;
+	}
 
-	virtual bool scatter(Ray const& r_in, HitRecord const& rec, float& scatterAmount, Ray& scattered) const {
-		Vec3 target = rec.p + rec.normal + RandInSphere();
-		scattered = Ray(rec.p, target - rec.p);
-		scatterAmount = mScatterAmount;
+	// Lambert plus the glossy lobe
+	Vec3 Eval(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const {
+		Vec3 const normal = FaceForward(rec.normal, wo);
+		if (dot(wi, normal) <= 0.f) {
+			return Vec3(0, 0, 0);
+		}
+		return mDiffuse / M_PI + mSpecular * mLobe.Eval(wi, wo, normal);
+	}
+
+	bool Sample(Vec3 const& wo, HitRecord const& rec, Vec2 const& u, BsdfSample& s) const {
+		Vec3 const normal = FaceForward(rec.normal, wo);
+
+		// Pick a lobe with u.x() and stretch the remainder back over [0,1)
+		if (u.x() < mSpecularProb) {
+			s.wi = mLobe.Sample(wo, normal, Vec2(u.x() / mSpecularProb, u.y()));
+		} else {
+			float const uDiffuse = (u.x() - mSpecularProb) / (1.f - mSpecularProb);
+
+			// Cosine weighted hemisphere
+			Vec3 tangent, bitangent;
+			CoordinateSystem(normal, tangent, bitangent);
+			Vec3 const local = SquareToCosineHemisphere(Vec2(uDiffuse, u.y()));
+			s.wi = local.x() * tangent + local.y() * bitangent + local.z() * normal;
+		}
+
+		s.isDelta = false;
+		s.pdf = Pdf(s.wi, wo, rec);
+		if (!(s.pdf > 0.f)) {
+			return false;
+		}
+		s.f = Eval(s.wi, wo, rec);
 		return true;
 	}
 
+	// Both lobes could have picked wi
+	float Pdf(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const {
+		Vec3 const normal = FaceForward(rec.normal, wo);
+		float const diffusePdf = fmax(0.f, dot(wi, normal)) / M_PI;
+		float const specularPdf = mSpecularProb > 0.f ? mLobe.Pdf(wi, wo, normal) : 0.f;
+		return (1.f - mSpecularProb) * diffusePdf + mSpecularProb * specularPdf;
+	}
+
 	Vec3 mDiffuse;
 	Vec3 mSpecular;
 	float mShinyness;
-	float mScatterAmount = 0.4f;
+	Glossy mLobe;
+	float mSpecularProb;
 };
 
 class FlatColor : public Material {
 public:
 		
-	FlatColor(Vec3 const& col) : mColor(col) {}
-	virtual bool scatter(Ray const& r_in, HitRecord const& rec, float& scatterAmount, Ray& scattered) const {
-		return false; // Single colors do not scatter
-	}
+	FlatColor(Vec3 const& col) : Material(kFlatColorMaterial), mColor(col) {}
+
+	// Single colors do not scatter
 
 	Vec3 mColor;
 };
 
+// Surface of a light, its radiance comes from the light
+class Emissive : public Material {
+public:
+
+	Emissive(Light const* light) : Material(kEmissiveMaterial), mLight(light) {}
+
+	// Lights absorb everything
+
+	Light const* mLight;
+};
+
 /*class Lambertian : public Material {
 public:
 	Lambertian(Vec3 const& a) : albedo(a) {}
@@ -84,66 +253,127 @@ public:
 	float fuzz;
 };*/
 
+// Mirror when fuzz is 0, otherwise a GGX lobe with fuzz as the roughness
 class Metal : public Material {
 public:
-	Metal(Vec3 const& a, float const f) : albedo(a), fuzz(f) {}
+	Metal(Vec3 const& a, float const f) : Material(kMetalMaterial), albedo(a), fuzz(f) {
+		mLobe = Glossy(Glossy::kGGX, 0.f);
+		mLobe.mAlpha = fmax(fuzz, 0.001f);
+	}
 
-	virtual bool scatter(Ray const& r_in, HitRecord const& rec, Vec3& attenuation, Ray& scattered) const {
-		Vec3 reflected = Reflect(r_in.direction().unitVec(), rec.normal);
-		scattered = Ray(rec.p, reflected + fuzz * RandInSphere());
-		attenuation = albedo;
-		return (dot(scattered.direction(), rec.normal) > 0);
+	Vec3 Eval(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const {
+		if (fuzz <= 0.f) {
+			return Vec3(0, 0, 0);
+		}
+		Vec3 const normal = FaceForward(rec.normal, wo);
+		return Fresnel(dot(wi, (wi + wo).unitVec())) * mLobe.Eval(wi, wo, normal);
+	}
+
+	bool Sample(Vec3 const& wo, HitRecord const& rec, Vec2 const& u, BsdfSample& s) const {
+		Vec3 const normal = FaceForward(rec.normal, wo);
+		if (fuzz <= 0.f) {
+			s.wi = Reflect(-1 * wo, normal);
+			float const cosTheta = dot(s.wi, normal);
+			s.f = Fresnel(cosTheta) / cosTheta;
+			s.pdf = 1.f;
+			s.isDelta = true;
+			return cosTheta > 0.f;
+		}
+
+		s.wi = mLobe.Sample(wo, normal, u);
+		s.isDelta = false;
+		s.pdf = mLobe.Pdf(s.wi, wo, normal);
+		if (!(s.pdf > 0.f)) {
+			return false;
+		}
+		s.f = Eval(s.wi, wo, rec);
+		return true;
+	}
+
+	float Pdf(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const {
+		if (fuzz <= 0.f) {
+			return 0.f;
+		}
+		return mLobe.Pdf(wi, wo, FaceForward(rec.normal, wo));
+	}
+
+	// Schlick's approximation with the albedo as the reflectance at normal incidence
+	Vec3 Fresnel(float const cosine) const {
+		float const weight = pow(1.f - fmax(0.f, cosine), 5);
+		return albedo + (Vec3(1.f, 1.f, 1.f) - albedo) * weight;
 	}
 
 	Vec3 albedo;
 	float fuzz;
+	Glossy mLobe;
 };
 
 
 class Dielectric : public Material {
 public:
-	Dielectric(float const ri) : ref_idx(ri) {}
+	Dielectric(float const ri) : Material(kDielectricMaterial), ref_idx(ri) {}
+
+	// Reflect or refract with the Fresnel probability so each choice has unit weight
+	bool Sample(Vec3 const& wo, HitRecord const& rec, Vec2 const& u, BsdfSample& s) const {
+		// Calculate the normal based on if the ray is inside or outside the surface
+		bool const entering = dot(wo, rec.normal) > 0.f;
+		Vec3 const normal = entering ? rec.normal : -1 * rec.normal;
+		float const eta = entering ? 1.f / ref_idx : ref_idx;
+		float const cosI = dot(wo, normal);
 
-	virtual bool scatter(Ray const& r_in, HitRecord const& rec, Vec3& attenuation, Ray& scattered) const {
-		Vec3 outward_normal;
-		Vec3 reflected = Reflect(r_in.direction(), rec.normal);
 		Vec3 refracted;
-		float ratio_of_indicies;
-		attenuation = Vec3(1.0, 1.0, 1.0);
-		float reflect_prob;
-		float cosine;
+		bool const canRefract = Refract(-1 * wo, normal, eta, refracted);
+		float const reflectProb = canRefract ? FresnelDielectric(cosI, eta) : 1.f;
 
-		// Calculate the normal based on if the ray is inside or outside the sphere
-		if (dot(r_in.direction(), rec.normal) > 0) {
-			outward_normal = rec.normal * -1;
-			ratio_of_indicies = ref_idx;
-			cosine = ref_idx * dot(r_in.direction(), rec.normal) / r_in.direction().length();
-		}
-		else {
-			outward_normal = rec.normal;
-			ratio_of_indicies = 1.0f / ref_idx;
-			cosine = -1 * dot(r_in.direction(), rec.normal) / r_in.direction().length();
+		s.pdf = 1.f;
+		s.isDelta = true;
+		if (u.x() < reflectProb) {
+			s.wi = Reflect(-1 * wo, normal);
+			s.f = Vec3(1.f, 1.f, 1.f) / dot(s.wi, normal);
+		} else {
+			// Radiance is compressed into the smaller solid angle on the denser side
+			s.wi = refracted.unitVec();
+			s.f = Vec3(1.f, 1.f, 1.f) * (eta * eta / fabs(dot(s.wi, normal)));
 		}
+		return true;
+	}
 
-		// Refract the ray
-		if (Refract(r_in.direction(), outward_normal, ratio_of_indicies, refracted)) {
-			reflect_prob = Schlick(cosine, ref_idx);
-		}
-		else {
-			scattered = Ray(rec.p, reflected);
-			reflect_prob = 1.0f;
-		}
+	float ref_idx;
+};
 
-		// Decide to reflect or refract randomly
-		if (RandFloat() < reflect_prob) {
-			scattered = Ray(rec.p, reflected);
-		}
-		else {
-			scattered = Ray(rec.p, refracted);
-		}
-		return true;
 
+// Materials without a lobe fall through to black
+inline Vec3 Material::Eval(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const {
+	switch (mType) {
+	case kSolidMaterial:
+		return static_cast<Solid const*>(this)->Eval(wi, wo, rec);
+	case kMetalMaterial:
+		return static_cast<Metal const*>(this)->Eval(wi, wo, rec);
+	default:
+		return Vec3(0, 0, 0);
 	}
+}
 
-	float ref_idx;
-};
\ No newline at end of file
+inline bool Material::Sample(Vec3 const& wo, HitRecord const& rec, Vec2 const& u, BsdfSample& s) const {
+	switch (mType) {
+	case kSolidMaterial:
+		return static_cast<Solid const*>(this)->Sample(wo, rec, u, s);
+	case kMetalMaterial:
+		return static_cast<Metal const*>(this)->Sample(wo, rec, u, s);
+	case kDielectricMaterial:
+		return static_cast<Dielectric const*>(this)->Sample(wo, rec, u, s);
+	default:
+		return false;
+	}
+}
+
+inline float Material::Pdf(Vec3 const& wi, Vec3 const& wo, HitRecord const& rec) const {
+	switch (mType) {
+	case kSolidMaterial:
+		return static_cast<Solid const*>(this)->Pdf(wi, wo, rec);
+	case kMetalMaterial:
+		return static_cast<Metal const*>(this)->Pdf(wi, wo, rec);
+	default:
+		return 0.f;
+	}
+}
\ No newline at end of file
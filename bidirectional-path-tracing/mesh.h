@@ -1,60 +1,119 @@
 #pragma once
+#if !defined(NO_ASSIMP)
 #include "assimp/scene.h"
-#include "triangle.h"
+#endif
 #include "BVH.h"
+#include "VertexBuffer.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include <string.h>
 #include <vector>
 
+// A material as a model file describes it, plain data so it can go in a scene cache
+struct MeshMaterial {
+	MeshMaterial() : mShininess(0.f), mPresent(0) {
+		for (int channel = 0; channel < 3; ++channel) {
+			mDiffuse[channel] = 0.f;
+			mSpecular[channel] = 0.f;
+		}
+	}
+
+	float mDiffuse[3];
+	float mSpecular[3];
+	float mShininess;
+	uint32_t mPresent; // 0 when the file doesn't give the mesh one
+};
+
 class Mesh : public Object
 {
 public:
-	Mesh(aiMesh const* mesh, aiMaterial const* material) {
+#if !defined(NO_ASSIMP)
+	Mesh(aiMesh const* mesh, aiMaterial const* material, Arena& arena) : mAccelerationStructure(nullptr), material(nullptr) {
 		aiVector3D const Zero3D(0.0f, 0.0f, 0.0f);
 
 		// Store the verticies
+		mVertices.Reserve(mesh->mNumVertices);
 		for (uint32_t ii = 0; ii < mesh->mNumVertices; ++ii) {
 			aiVector3D const* pPos = &(mesh->mVertices[ii]);
-			aiVector3D const* pNormal = &(mesh->mNormals[ii]) == NULL ? &Zero3D : &(mesh->mNormals[ii]);
+			aiVector3D const* pNormal = mesh->HasNormals() ? &(mesh->mNormals[ii]) : &Zero3D;
 			aiVector3D const* pTexCoord = mesh->HasTextureCoords(0) ? &(mesh->mTextureCoords[0][ii]) : &Zero3D;
 
-			mVerticies.push_back(Vertex(Vec3(pPos->x, pPos->y, pPos->z),
-				Vec3(pTexCoord->x, pTexCoord->y, 0),
-				Vec3(pNormal->x, pNormal->y, pNormal->z)));
+			mVertices.Add(Vec3(pPos->x, pPos->y, pPos->z),
+				Vec3(pNormal->x, pNormal->y, pNormal->z),
+				Vec2(pTexCoord->x, pTexCoord->y));
 
 			// Update the bounding box to include this vertex
 			mBoundingBox.Expand(Vec3(pPos->x, pPos->y, pPos->z));
 		}
 
 		// Store the indicies
+		mIndices = arena.NewArray<uint32_t>(mesh->mNumFaces * 3);
+		mIndexCount = 0;
 		for (uint32_t ii = 0; ii < mesh->mNumFaces; ++ii) {
 			aiFace const& face = mesh->mFaces[ii];
 			if (face.mNumIndices != 3) {
 				continue;
 			}
-			mIndicies.push_back(face.mIndices[0]);
-			mIndicies.push_back(face.mIndices[1]);
-			mIndicies.push_back(face.mIndices[2]);
+			mIndices[mIndexCount++] = face.mIndices[0];
+			mIndices[mIndexCount++] = face.mIndices[1];
+			mIndices[mIndexCount++] = face.mIndices[2];
 		}
 
-		// Create the triangles
-		uint32_t a, b, c;
-		for (uint32_t ii = 0; ii < mIndicies.size(); ii += 3) {
-			a = mIndicies[ii + 0];
-			b = mIndicies[ii + 1];
-			c = mIndicies[ii + 2];
-			Triangle* temp = new Triangle(mVerticies[a], mVerticies[b], mVerticies[c], nullptr); /* material set for entire mesh */
-			mTriangles.push_back(temp);
+		// The same parts of the material ObjLoader reads, so a model shades the same whichever loads it. assimp
+		// gives meshes the file doesn't give a material its default one
+		MeshMaterial fileMaterial;
+		aiString name;
+		if (material && material->Get(AI_MATKEY_NAME, name) == aiReturn_SUCCESS && strcmp(name.C_Str(), AI_DEFAULT_MATERIAL_NAME) != 0) {
+			aiColor3D diffuse(0.f, 0.f, 0.f);
+			aiColor3D specular(0.f, 0.f, 0.f);
+			material->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
+			material->Get(AI_MATKEY_COLOR_SPECULAR, specular);
+			material->Get(AI_MATKEY_SHININESS, fileMaterial.mShininess);
+			fileMaterial.mDiffuse[0] = diffuse.r;
+			fileMaterial.mDiffuse[1] = diffuse.g;
+			fileMaterial.mDiffuse[2] = diffuse.b;
+			fileMaterial.mSpecular[0] = specular.r;
+			fileMaterial.mSpecular[1] = specular.g;
+			fileMaterial.mSpecular[2] = specular.b;
+			fileMaterial.mPresent = 1;
 		}
+		SetFileMaterial(fileMaterial, arena);
+	}
+#endif
+
+	// Indexed buffers a loader built, which must outlive the mesh
+	Mesh(float* const* attributes, uint32_t const vertexCount, uint32_t* indices, uint32_t const indexCount)
+		: mIndices(indices), mIndexCount(indexCount), mAccelerationStructure(nullptr), material(nullptr) {
+		mVertices.View(attributes, vertexCount);
+	}
 
-		// Create the acceleration structure
-		mAccelerationStructure = new BVH(mTriangles, 0);
+	// Buffers and BVH that are already built, like ones mapped from a scene cache. They must outlive the mesh
+	Mesh(float* const* attributes, uint32_t const vertexCount, uint32_t* indices, uint32_t const indexCount, BVH* accelerationStructure)
+		: mIndices(indices), mIndexCount(indexCount), mAccelerationStructure(accelerationStructure), material(nullptr) {
+		mVertices.View(attributes, vertexCount);
+		mBoundingBox = accelerationStructure->mBoundingBox;
 	}
 
-	void Translate(Vec3 const& trans) {
-		Object::Translate(trans);
-		for (int jj = 0; jj < mTriangles.size(); ++jj) {
-			mTriangles[jj]->Translate(trans);
+	// Meshes from a loader can't be hit until this has run. It only touches this mesh, so meshes can be built on
+	// different threads at once
+	void BuildAccelerationStructure(Arena& arena) {
+		TRACE_SCOPE("BVH build", "triangles", (int)TriangleCount());
+		PERF_PHASE(kPerfBuild);
+		mAccelerationStructure = arena.New<BVH>(mVertices, mIndices, mIndexCount, arena);
+		mBoundingBox = mAccelerationStructure->mBoundingBox;
+	}
+
+	// Use the material the model file gives, if it gives one
+	void SetFileMaterial(MeshMaterial const& fileMaterial, Arena& arena) {
+		mFileMaterial = fileMaterial;
+		if (fileMaterial.mPresent) {
+			material = arena.New<Solid>(Vec3(fileMaterial.mDiffuse[0], fileMaterial.mDiffuse[1], fileMaterial.mDiffuse[2]),
+				Vec3(fileMaterial.mSpecular[0], fileMaterial.mSpecular[1], fileMaterial.mSpecular[2]), fileMaterial.mShininess);
 		}
-		mAccelerationStructure->Translate(trans);
+	}
+
+	uint32_t TriangleCount() const {
+		return mIndexCount / 3;
 	}
 
 	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const {
@@ -65,12 +124,23 @@ public:
 		return false;
 	}
 
-	// Structures only used for creating the polygons later
-	std::vector<Vertex> mVerticies;
-	std::vector<uint32_t> mIndicies;
-	std::vector<Triangle*> mTriangles;
+	virtual uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		uint32_t const hit = mAccelerationStructure->HitPacket(packet, t_min, rec, mask);
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			if (hit & (1u << ii)) {
+				rec.rec[ii].material = material;
+			}
+		}
+		return hit;
+	}
+
+	// Three indices into mVertices per triangle
+	VertexBuffer mVertices;
+	uint32_t* mIndices;
+	uint32_t mIndexCount;
 
 	BVH* mAccelerationStructure;
 
+	MeshMaterial mFileMaterial;
 	Material* material;
 };
\ No newline at end of file
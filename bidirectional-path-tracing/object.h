@@ -1,6 +1,8 @@
 #pragma once
 
 #include "ray.h"
+#include "RayPacket.h"
+#include "Stats.h"
 #include "Box.h"
 
 class Material;
@@ -13,11 +15,33 @@ struct HitRecord {
 	Material* material;
 };
 
+// Closest hit so far for each lane of a packet, t starts at the lane's t_max
+struct PacketHitRecord {
+	float t[PACKET_SIZE];
+	HitRecord rec[PACKET_SIZE];
+};
+
 class Object {
 public:
 	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const = 0;
-	virtual bool HitBB(Ray const& r) const {
-		return mBoundingBox.Hit(r);
+
+	// Updates the lanes in mask that hit closer than rec.t and returns them. Objects without a packet
+	// version trace each lane on its own
+	virtual uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		uint32_t hit = 0;
+		HitRecord temp_record;
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			if ((mask & (1u << ii)) && Hit(packet.GetRay(ii), t_min, rec.t[ii], temp_record)) {
+				rec.t[ii] = temp_record.t;
+				rec.rec[ii] = temp_record;
+				hit |= 1u << ii;
+			}
+		}
+		return hit;
+	}
+
+	virtual bool HitBB(Ray const& r, float const t_min, float const t_max) const {
+		return mBoundingBox.Intersects(r, t_min, t_max);
 	}
 
 	virtual void Translate(Vec3 const& trans) {
@@ -1,25 +1,44 @@
 #pragma once
 
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
 #include "vec3.h"
 
+// Offset that keeps rays leaving a surface from hitting it again
+float const kRayEpsilon = 0.001f;
+
+// Stands in for the infinite inverse of a zero direction component. Finite so origin * invDir stays finite and the
+// slab test in Box doesn't turn 0 * inf into NaN for rays parallel to an axis
+float const kRayMaxInvDir = 1e30f;
+
+inline float SafeInverse(float const d) {
+	return fabs(d) > 1.f / kRayMaxInvDir ? 1.f / d : copysign(kRayMaxInvDir, d);
+}
+
 class Ray
 {
 public:
 	Ray() {}
-	Ray(Vec3 const& a, Vec3 const& b) { 
+	Ray(Vec3 const& a, Vec3 const& b, float const t_min = kRayEpsilon, float const t_max = FLT_MAX) { 
 		A = a; 
 		B = b;
-		invDir = 1.f / B;
-		sign[0] = !signbit(B.x());
-		sign[1] = !signbit(B.y());
-		sign[2] = !signbit(B.z());
+		invDir = Vec3(SafeInverse(B.x()), SafeInverse(B.y()), SafeInverse(B.z()));
+		originInvDir = A * invDir;
+		tMin = t_min;
+		tMax = t_max;
+		sign[0] = signbit(B.x()) ? 1 : 0;
+		sign[1] = signbit(B.y()) ? 1 : 0;
+		sign[2] = signbit(B.z()) ? 1 : 0;
 	}
-	Vec3 origin() const { return A; }
-	Vec3 direction() const { return B; }
+	Vec3 const& origin() const { return A; }
+	Vec3 const& direction() const { return B; }
 	Vec3 negDirection() const { return -1 * B; }
 	Vec3 point_at_parameter(float const t) const { return A + B * t; }
 
 	Vec3 A, B;
 	Vec3 invDir;
-	bool sign[3];
+	Vec3 originInvDir; // Slab distances are then bound * invDir - originInvDir, one FMA per axis
+	float tMin, tMax;
+	uint8_t sign[3]; // 1 where the direction is negative, which is also the index of the nearer child along that axis
 };
\ No newline at end of file
@@ -12,6 +12,8 @@ public:
 
 	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const
 	{
+		STAT_INC(kSphereTests);
+
 		Vec3 const oc = r.origin() - center;
 		float const a = dot(r.direction(), r.direction());
 		float const b = dot(oc, r.direction());
@@ -39,6 +41,52 @@ public:
 		return false;
 	}
 
+	// Same test as Hit() for every lane at once
+	virtual uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		STAT_ADD(kSphereTests, LaneCount(mask));
+
+		float const cx = center.x(), cy = center.y(), cz = center.z();
+
+		float tHit[PACKET_SIZE];
+		int laneHit[PACKET_SIZE];
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			float const ocx = packet.mOriginX[ii] - cx;
+			float const ocy = packet.mOriginY[ii] - cy;
+			float const ocz = packet.mOriginZ[ii] - cz;
+			float const a = packet.mDirX[ii] * packet.mDirX[ii] + packet.mDirY[ii] * packet.mDirY[ii] + packet.mDirZ[ii] * packet.mDirZ[ii];
+			float const b = ocx * packet.mDirX[ii] + ocy * packet.mDirY[ii] + ocz * packet.mDirZ[ii];
+			float const c = ocx * ocx + ocy * ocy + ocz * ocz - radius * radius;
+			float const discriminant = b * b - a * c;
+			float const root = sqrtf(discriminant > 0.f ? discriminant : 0.f);
+
+			// Nearer root first, the far one when the near one is out of range
+			float const nearT = (-b - root) / a;
+			float const farT = (-b + root) / a;
+			int const nearHit = (nearT < rec.t[ii]) & (nearT > t_min);
+			int const farHit = (farT < rec.t[ii]) & (farT > t_min);
+			tHit[ii] = nearHit ? nearT : farT;
+			laneHit[ii] = (discriminant > 0.f) & (nearHit | farHit);
+		}
+
+		uint32_t hit = 0;
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			hit |= (uint32_t)laneHit[ii] << ii;
+		}
+		hit &= mask;
+
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			if (hit & (1u << ii)) {
+				HitRecord& laneRec = rec.rec[ii];
+				rec.t[ii] = tHit[ii];
+				laneRec.t = tHit[ii];
+				laneRec.p = Vec3(packet.mOriginX[ii], packet.mOriginY[ii], packet.mOriginZ[ii]) + tHit[ii] * Vec3(packet.mDirX[ii], packet.mDirY[ii], packet.mDirZ[ii]);
+				laneRec.normal = (laneRec.p - center) / radius;
+				laneRec.material = material;
+			}
+		}
+		return hit;
+	}
+
 	Vec3 center;
 	float radius;
 	Material* material;
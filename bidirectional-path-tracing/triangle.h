@@ -47,6 +47,8 @@ public:
 
 	virtual bool Hit(Ray const& r, float const t_min, float const t_max, HitRecord& rec) const
 	{
+		STAT_INC(kTriangleTests);
+
 		// Project r onto the plane of the Polygon
 		float const t = dot(A.mPos - r.origin(), NHat) / dot(r.direction(), NHat);
 
@@ -78,6 +80,54 @@ public:
 		return true;
 	}
 
+	// Same test as Hit() for every lane at once
+	virtual uint32_t HitPacket(RayPacket const& packet, float const t_min, PacketHitRecord& rec, uint32_t const mask) const {
+		STAT_ADD(kTriangleTests, LaneCount(mask));
+
+		float const nx = NHat.x(), ny = NHat.y(), nz = NHat.z();
+		float const ax = A.mPos.x(), ay = A.mPos.y(), az = A.mPos.z();
+		float const abx = AB.x(), aby = AB.y(), abz = AB.z();
+		float const acx = AC.x(), acy = AC.y(), acz = AC.z();
+
+		float tHit[PACKET_SIZE];
+		int laneHit[PACKET_SIZE];
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			float const t = ((ax - packet.mOriginX[ii]) * nx + (ay - packet.mOriginY[ii]) * ny + (az - packet.mOriginZ[ii]) * nz)
+				/ (packet.mDirX[ii] * nx + packet.mDirY[ii] * ny + packet.mDirZ[ii] * nz);
+
+			// Offset of the plane hit from A, then barycentric coordinates
+			float const px = packet.mOriginX[ii] + packet.mDirX[ii] * t - ax;
+			float const py = packet.mOriginY[ii] + packet.mDirY[ii] * t - ay;
+			float const pz = packet.mOriginZ[ii] + packet.mDirZ[ii] * t - az;
+			float const distCent = px * abx + py * aby + pz * abz;
+			float const distCent2 = px * acx + py * acy + pz * acz;
+			float const a = (dACAC * distCent - dABAC * distCent2) * denominator;
+			float const b = (dABAB * distCent2 - dABAC * distCent) * denominator;
+			float const c = 1.f - a - b;
+
+			tHit[ii] = t;
+			laneHit[ii] = (t >= t_min) & (t <= rec.t[ii]) & (a >= 0.f) & (b >= 0.f) & (c >= 0.f) & (a <= 1.f) & (b <= 1.f) & (c <= 1.f);
+		}
+
+		uint32_t hit = 0;
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			hit |= (uint32_t)laneHit[ii] << ii;
+		}
+		hit &= mask;
+
+		for (int ii = 0; ii < kPacketSize; ++ii) {
+			if (hit & (1u << ii)) {
+				HitRecord& laneRec = rec.rec[ii];
+				rec.t[ii] = tHit[ii];
+				laneRec.t = tHit[ii];
+				laneRec.p = Vec3(packet.mOriginX[ii], packet.mOriginY[ii], packet.mOriginZ[ii]) + tHit[ii] * Vec3(packet.mDirX[ii], packet.mDirY[ii], packet.mDirZ[ii]);
+				laneRec.normal = NHat;
+				laneRec.material = material;
+			}
+		}
+		return hit;
+	}
+
 	void Translate(Vec3 const& trans) {
 		A.mPos += trans;
 		B.mPos += trans;
@@ -1,37 +1,60 @@
 #pragma once
 
+#include <stdio.h>
 #include "vec3.h"
-
-namespace {
-	std::default_random_engine generator(time(NULL));
-	std::normal_distribution<double> distribution(0.f, 1.f);
-}
-
+#include "vec2.h"
+#include "Warp.h"
 
 template<typename T> 
 bool isType(void* inp) {
 	return dynamic_cast<T>(inp);
 }
 
+// fopen, through fopen_s where the secure CRT wants it. nullptr on failure
+FILE* OpenFile(char const* path, char const* mode) {
+#if defined(_MSC_VER)
+	FILE* file = nullptr;
+	return fopen_s(&file, path, mode) == 0 ? file : nullptr;
+#else
+	return fopen(path, mode);
+#endif
+}
+
+// Uniform in [0,1)
 float RandFloat() {
-	return (float)rand() / (float)(RAND_MAX - 1);
+	return (float)fmin((double)rand() / ((double)RAND_MAX + 1.0), 0.99999994);
 }
 
+// Uniform direction, not a point inside the sphere despite the name
 Vec3 RandInSphere() {
-	static Vec3 p;
-	p[0] = distribution(generator);
-	p[1] = distribution(generator);
-	p[2] = distribution(generator);
-	p.normalize();
-	return p;
+	return SquareToUniformSphere(Vec2(RandFloat(), RandFloat()));
 }
 
 Vec3 RandInDisk() {
-	Vec3 p;
-	do {
-		p = 2.0 * Vec3(RandFloat(), RandFloat(), 0) - Vec3(1, 1, 0);
-	} while (dot(p, p) >= 1.0f);
-	return p;
+	Vec2 const d = SquareToConcentricDisk(Vec2(RandFloat(), RandFloat()));
+	return Vec3(d.x(), d.y(), 0);
+}
+
+// Build two unit vectors perpendicular to the unit vector v1 and each other
+void CoordinateSystem(Vec3 const& v1, Vec3& v2, Vec3& v3) {
+	if (fabs(v1.x()) > fabs(v1.y())) {
+		v2 = Vec3(-v1.z(), 0, v1.x()) / sqrt(v1.x() * v1.x() + v1.z() * v1.z());
+	} else {
+		v2 = Vec3(0, v1.z(), -v1.y()) / sqrt(v1.y() * v1.y() + v1.z() * v1.z());
+	}
+	v3 = cross(v1, v2);
+}
+
+// Flip the normal onto the same side as v
+Vec3 FaceForward(Vec3 const& normal, Vec3 const& v) {
+	return dot(normal, v) < 0.f ? -1 * normal : normal;
+}
+
+// Weight for a sample from a strategy with density fPdf when another strategy has density gPdf
+float PowerHeuristic(float const fPdf, float const gPdf) {
+	float const f = fPdf * fPdf;
+	float const g = gPdf * gPdf;
+	return f + g > 0.f ? f / (f + g) : 0.f;
 }
 
 Vec3 Reflect(Vec3 const& incident, Vec3 const& normal) {
@@ -53,4 +76,16 @@ float Schlick(float const cosine, float const ref_idx) {
 	float r0 = (1 - ref_idx) / (1 + ref_idx);
 	r0 = r0 * r0;
 	return r0 + (1 - r0) * pow(1 - cosine, 5);
+}
+
+// Unpolarized reflectance at incident cosine cosI, eta is the incident over the transmitted index
+float FresnelDielectric(float const cosI, float const eta) {
+	float const sinTSquared = eta * eta * fmax(0.f, 1.f - cosI * cosI);
+	if (sinTSquared >= 1.f) {
+		return 1.f; // Total internal reflection
+	}
+	float const cosT = sqrt(1.f - sinTSquared);
+	float const parallel = (cosI - eta * cosT) / (cosI + eta * cosT);
+	float const perpendicular = (eta * cosI - cosT) / (eta * cosI + cosT);
+	return 0.5f * (parallel * parallel + perpendicular * perpendicular);
 }
\ No newline at end of file
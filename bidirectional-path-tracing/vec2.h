@@ -0,0 +1,18 @@
+#pragma once
+
+class Vec2 {
+
+protected:
+	float e[2];
+
+public:
+	Vec2() {}
+	Vec2(float const e0, float const e1) { e[0] = e0; e[1] = e1; }
+
+	// Accessor and setter methods
+	inline float x() const { return e[0]; }
+	inline float y() const { return e[1]; }
+
+	inline float operator[](int const i) const { return e[i]; }
+	inline float& operator[](int const i) { return e[i]; };
+};
\ No newline at end of file
@@ -2,14 +2,94 @@
 
 #include <math.h>
 
-class Vec3 {
+// Backend for the vector math, define VEC_ISA before including to override what the compiler targets.
+// The AVX2 backend is the SSE one with FMA, a 3 vector doesn't fill a wider register. MSVC never defines
+// __SSE4_1__ and only defines __AVX2__ under /arch:AVX2, which the project's Release builds set
+#define VEC_ISA_SCALAR 0
+#define VEC_ISA_SSE4 1
+#define VEC_ISA_AVX2 2
+
+#ifndef VEC_ISA
+#if defined(__AVX2__)
+#define VEC_ISA VEC_ISA_AVX2
+#elif defined(__SSE4_1__) || defined(__AVX__)
+#define VEC_ISA VEC_ISA_SSE4
+#else
+#define VEC_ISA VEC_ISA_SCALAR
+#endif
+#endif
+
+// Refine the SIMD reciprocal square root once, without it unit vectors are only good to about 12 bits
+#ifndef VEC_RSQRT_NEWTON
+#define VEC_RSQRT_NEWTON 1
+#endif
+
+#if VEC_ISA == VEC_ISA_AVX2
+#include <immintrin.h>
+#elif VEC_ISA == VEC_ISA_SSE4
+#include <smmintrin.h>
+#endif
+
+#if VEC_ISA != VEC_ISA_SCALAR
+// a * b + c
+inline __m128 MulAdd4(__m128 const a, __m128 const b, __m128 const c) {
+#if VEC_ISA == VEC_ISA_AVX2
+	return _mm_fmadd_ps(a, b, c);
+#else
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// a * b - c
+inline __m128 MulSub4(__m128 const a, __m128 const b, __m128 const c) {
+#if VEC_ISA == VEC_ISA_AVX2
+	return _mm_fmsub_ps(a, b, c);
+#else
+	return _mm_sub_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// Sum of the first three lanes in the lowest lane
+inline __m128 HorizontalSum3(__m128 const v) {
+	__m128 const xz = _mm_add_ss(v, _mm_movehl_ps(v, v));
+	return _mm_add_ss(xz, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));
+}
+
+// 1 / sqrt(v) in every lane
+inline __m128 RSqrt4(__m128 const v) {
+	__m128 r = _mm_rsqrt_ps(v);
+#if VEC_RSQRT_NEWTON
+	// r * (1.5 - 0.5 * v * r * r)
+	__m128 const halfVR = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), v), r);
+	r = _mm_mul_ps(r, MulSub4(_mm_set1_ps(-1.f), _mm_mul_ps(halfVR, r), _mm_set1_ps(-1.5f)));
+#endif
+	return r;
+}
+#endif
+
+class alignas(16) Vec3 {
 
 protected:
-	float e[3];
+	// The fourth lane is padding, it can pick up NaN from division so nothing reads it
+#if VEC_ISA == VEC_ISA_SCALAR
+	float e[4];
+#else
+	union {
+		__m128 m;
+		float e[4];
+	};
+#endif
 
 public:
 	Vec3() {}
-	Vec3(float const e0, float const e1, float const e2) { e[0] = e0; e[1] = e1; e[2] = e2; }
+#if VEC_ISA == VEC_ISA_SCALAR
+	Vec3(float const e0, float const e1, float const e2) { e[0] = e0; e[1] = e1; e[2] = e2; e[3] = 0.f; }
+#else
+	Vec3(float const e0, float const e1, float const e2) : m(_mm_set_ps(0.f, e2, e1, e0)) {}
+	explicit Vec3(__m128 const v) : m(v) {}
+
+	inline __m128 simd() const { return m; }
+#endif
 
 	// Accessor and setter methods
 	inline float x() const { return e[0]; }
@@ -19,10 +99,10 @@ public:
 	inline float g() const { return e[1]; }
 	inline float b() const { return e[2]; }
 
-	inline void operator=(Vec3 const& v2) { e[0] = v2.e[0]; e[1] = v2.e[1]; e[2] = v2.e[2]; }
 	inline float operator[](int const i) const { return e[i]; }
 	inline float& operator[](int const i) { return e[i]; };
 
+#if VEC_ISA == VEC_ISA_SCALAR
 	// Operations that don't modify the vector
 	inline Vec3 operator+(Vec3 const& v2) const { return Vec3(e[0] + v2.e[0], e[1] + v2.e[1], e[2] + v2.e[2]); }
 	inline Vec3 operator-(Vec3 const& v2) const { return Vec3(e[0] - v2.e[0], e[1] - v2.e[1], e[2] - v2.e[2]); }
@@ -32,29 +112,90 @@ public:
 	inline Vec3 operator/(float const t) const { return Vec3(e[0] / t, e[1] / t, e[2] / t); }
 
 	// Operations that modify the vector
-	inline Vec3& operator+=(Vec3 const& v2) { *this = *this + v2; return *this; }
-	inline Vec3& operator-=(Vec3 const& v2) { *this = *this - v2; return *this; }
-	inline Vec3& operator*=(Vec3 const& v2) { *this = *this * v2; return *this; }
-	inline Vec3& operator/=(Vec3 const& v2) { *this = *this / v2; return *this; }
-	inline Vec3& operator*=(float const t) { *this = *this * t; return *this; }
-	inline Vec3& operator/=(float const t) { *this = *this / t; return *this; }
+	inline Vec3& operator+=(Vec3 const& v2) { e[0] += v2.e[0]; e[1] += v2.e[1]; e[2] += v2.e[2]; return *this; }
+	inline Vec3& operator-=(Vec3 const& v2) { e[0] -= v2.e[0]; e[1] -= v2.e[1]; e[2] -= v2.e[2]; return *this; }
+	inline Vec3& operator*=(Vec3 const& v2) { e[0] *= v2.e[0]; e[1] *= v2.e[1]; e[2] *= v2.e[2]; return *this; }
+	inline Vec3& operator/=(Vec3 const& v2) { e[0] /= v2.e[0]; e[1] /= v2.e[1]; e[2] /= v2.e[2]; return *this; }
+	inline Vec3& operator*=(float const t) { e[0] *= t; e[1] *= t; e[2] *= t; return *this; }
+	inline Vec3& operator/=(float const t) { e[0] /= t; e[1] /= t; e[2] /= t; return *this; }
 
 	// Utility functions
-	inline float length() const { return sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]); }
+	inline float length() const { return sqrt(lengthSquared()); }
 	inline float lengthSquared() const { return e[0] * e[0] + e[1] * e[1] + e[2] * e[2]; }
-	inline void normalize() { *this /= this->length(); }
-	inline Vec3 unitVec() const { return *this / this->length(); }
-	inline void clamp() { this->e[0] = fmin(1.f, fmax(0.f, this->e[0])); this->e[1] = fmin(1.f, fmax(0.f, this->e[1])); this->e[2] = fmin(1.f, fmax(0.f, this->e[2])); }
+	inline void normalize() { *this *= 1.f / length(); }
+	inline Vec3 unitVec() const { return *this * (1.f / length()); }
+	inline void clamp() { e[0] = fmin(1.f, fmax(0.f, e[0])); e[1] = fmin(1.f, fmax(0.f, e[1])); e[2] = fmin(1.f, fmax(0.f, e[2])); }
+	inline float minComponent() const { float const m = e[0] < e[1] ? e[0] : e[1]; return m < e[2] ? m : e[2]; }
+	inline float maxComponent() const { float const m = e[0] > e[1] ? e[0] : e[1]; return m > e[2] ? m : e[2]; }
+#else
+	// Operations that don't modify the vector
+	inline Vec3 operator+(Vec3 const& v2) const { return Vec3(_mm_add_ps(m, v2.m)); }
+	inline Vec3 operator-(Vec3 const& v2) const { return Vec3(_mm_sub_ps(m, v2.m)); }
+	inline Vec3 operator*(Vec3 const& v2) const { return Vec3(_mm_mul_ps(m, v2.m)); }
+	inline Vec3 operator/(Vec3 const& v2) const { return Vec3(_mm_div_ps(m, v2.m)); }
+	inline Vec3 operator*(float const t) const { return Vec3(_mm_mul_ps(m, _mm_set1_ps(t))); }
+	inline Vec3 operator/(float const t) const { return Vec3(_mm_div_ps(m, _mm_set1_ps(t))); }
+
+	// Operations that modify the vector
+	inline Vec3& operator+=(Vec3 const& v2) { m = _mm_add_ps(m, v2.m); return *this; }
+	inline Vec3& operator-=(Vec3 const& v2) { m = _mm_sub_ps(m, v2.m); return *this; }
+	inline Vec3& operator*=(Vec3 const& v2) { m = _mm_mul_ps(m, v2.m); return *this; }
+	inline Vec3& operator/=(Vec3 const& v2) { m = _mm_div_ps(m, v2.m); return *this; }
+	inline Vec3& operator*=(float const t) { m = _mm_mul_ps(m, _mm_set1_ps(t)); return *this; }
+	inline Vec3& operator/=(float const t) { m = _mm_div_ps(m, _mm_set1_ps(t)); return *this; }
+
+	// Utility functions
+	inline float length() const { return _mm_cvtss_f32(_mm_sqrt_ss(HorizontalSum3(_mm_mul_ps(m, m)))); }
+	inline float lengthSquared() const { return _mm_cvtss_f32(HorizontalSum3(_mm_mul_ps(m, m))); }
+	inline void normalize() { *this = unitVec(); }
+	inline Vec3 unitVec() const {
+		__m128 const sum = HorizontalSum3(_mm_mul_ps(m, m));
+		__m128 const lengthSquared = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(0, 0, 0, 0));
+		return Vec3(_mm_mul_ps(m, RSqrt4(lengthSquared)));
+	}
+	inline void clamp() { m = _mm_min_ps(_mm_set1_ps(1.f), _mm_max_ps(_mm_setzero_ps(), m)); }
+	inline float minComponent() const { return _mm_cvtss_f32(_mm_min_ss(_mm_min_ss(m, _mm_movehl_ps(m, m)), _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)))); }
+	inline float maxComponent() const { return _mm_cvtss_f32(_mm_max_ss(_mm_max_ss(m, _mm_movehl_ps(m, m)), _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)))); }
+#endif
 };
 
+#if VEC_ISA == VEC_ISA_SCALAR
 // Commutativity operations
 inline Vec3 operator*(float const t, Vec3 const& v2) { return Vec3(t * v2[0], t * v2[1], t * v2[2]); }
 inline Vec3 operator/(float const t, Vec3 const& v2) { return Vec3(t / v2[0], t / v2[1], t / v2[2]); }
 
-// Utility functions not called on an instance
-inline Vec3 normalize(Vec3 const& v1) { return v1 / v1.length(); }
-inline float magnitudeSquared(Vec3 const& v1) { return v1.x() * v1.x() + v1.y() * v1.y() + v1.z() * v1.z(); }
 inline float dot(Vec3 const& v1, Vec3 const& v2) { return v1.x() * v2.x() + v1.y() * v2.y() + v1.z() * v2.z(); }
 inline Vec3 cross(Vec3 const& v1, Vec3 const& v2) { return Vec3((v1.y() * v2.z() - v1.z() * v2.y()), -(v1.x() * v2.z() - v1.z() * v2.x()), (v1.x() * v2.y() - v1.y() * v2.x())); }
+
+// v1 * v2 - v3, left for the compiler to contract
+inline Vec3 mulSub(Vec3 const& v1, Vec3 const& v2, Vec3 const& v3) { return Vec3(v1.x() * v2.x() - v3.x(), v1.y() * v2.y() - v3.y(), v1.z() * v2.z() - v3.z()); }
+inline Vec3 componentMin(Vec3 const& v1, Vec3 const& v2) { return Vec3(v1.x() < v2.x() ? v1.x() : v2.x(), v1.y() < v2.y() ? v1.y() : v2.y(), v1.z() < v2.z() ? v1.z() : v2.z()); }
+inline Vec3 componentMax(Vec3 const& v1, Vec3 const& v2) { return Vec3(v1.x() > v2.x() ? v1.x() : v2.x(), v1.y() > v2.y() ? v1.y() : v2.y(), v1.z() > v2.z() ? v1.z() : v2.z()); }
+#else
+// Commutativity operations
+inline Vec3 operator*(float const t, Vec3 const& v2) { return v2 * t; }
+inline Vec3 operator/(float const t, Vec3 const& v2) { return Vec3(_mm_div_ps(_mm_set1_ps(t), v2.simd())); }
+
+inline float dot(Vec3 const& v1, Vec3 const& v2) { return _mm_cvtss_f32(HorizontalSum3(_mm_mul_ps(v1.simd(), v2.simd()))); }
+
+// (v1 * v2.yzx - v1.yzx * v2).yzx
+inline Vec3 cross(Vec3 const& v1, Vec3 const& v2) {
+	__m128 const a = v1.simd();
+	__m128 const b = v2.simd();
+	__m128 const aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 const bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 const c = MulSub4(a, bYZX, _mm_mul_ps(aYZX, b));
+	return Vec3(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+}
+
+// v1 * v2 - v3
+inline Vec3 mulSub(Vec3 const& v1, Vec3 const& v2, Vec3 const& v3) { return Vec3(MulSub4(v1.simd(), v2.simd(), v3.simd())); }
+inline Vec3 componentMin(Vec3 const& v1, Vec3 const& v2) { return Vec3(_mm_min_ps(v1.simd(), v2.simd())); }
+inline Vec3 componentMax(Vec3 const& v1, Vec3 const& v2) { return Vec3(_mm_max_ps(v1.simd(), v2.simd())); }
+#endif
+
+// Utility functions not called on an instance
+inline Vec3 normalize(Vec3 const& v1) { return v1.unitVec(); }
+inline float magnitudeSquared(Vec3 const& v1) { return v1.lengthSquared(); }
 inline Vec3 proj(Vec3 const& onto, Vec3 const& v2) { return dot(onto, v2) / dot(onto, onto) * onto; }
 inline float angle(Vec3 const& first, Vec3 const& second) { return acos(dot(first, second) / sqrt(first.lengthSquared() * second.lengthSquared())); }
\ No newline at end of file
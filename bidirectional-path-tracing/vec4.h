@@ -0,0 +1,88 @@
+#pragma once
+
+#include "vec3.h"
+
+// Four wide counterpart of Vec3 on the same backend, for RGBA and homogeneous values
+class alignas(16) Vec4 {
+
+protected:
+#if VEC_ISA == VEC_ISA_SCALAR
+	float e[4];
+#else
+	union {
+		__m128 m;
+		float e[4];
+	};
+#endif
+
+public:
+	Vec4() {}
+#if VEC_ISA == VEC_ISA_SCALAR
+	Vec4(float const e0, float const e1, float const e2, float const e3) { e[0] = e0; e[1] = e1; e[2] = e2; e[3] = e3; }
+	Vec4(Vec3 const& v, float const e3) { e[0] = v.x(); e[1] = v.y(); e[2] = v.z(); e[3] = e3; }
+
+	inline Vec3 xyz() const { return Vec3(e[0], e[1], e[2]); }
+#else
+	Vec4(float const e0, float const e1, float const e2, float const e3) : m(_mm_set_ps(e3, e2, e1, e0)) {}
+	Vec4(Vec3 const& v, float const e3) : m(_mm_insert_ps(v.simd(), _mm_set_ss(e3), 0x30)) {}
+	explicit Vec4(__m128 const v) : m(v) {}
+
+	inline __m128 simd() const { return m; }
+	inline Vec3 xyz() const { return Vec3(m); }
+#endif
+
+	// Accessor and setter methods
+	inline float x() const { return e[0]; }
+	inline float y() const { return e[1]; }
+	inline float z() const { return e[2]; }
+	inline float w() const { return e[3]; }
+	inline float r() const { return e[0]; }
+	inline float g() const { return e[1]; }
+	inline float b() const { return e[2]; }
+	inline float a() const { return e[3]; }
+
+	inline float operator[](int const i) const { return e[i]; }
+	inline float& operator[](int const i) { return e[i]; };
+
+#if VEC_ISA == VEC_ISA_SCALAR
+	// Operations that don't modify the vector
+	inline Vec4 operator+(Vec4 const& v2) const { return Vec4(e[0] + v2.e[0], e[1] + v2.e[1], e[2] + v2.e[2], e[3] + v2.e[3]); }
+	inline Vec4 operator-(Vec4 const& v2) const { return Vec4(e[0] - v2.e[0], e[1] - v2.e[1], e[2] - v2.e[2], e[3] - v2.e[3]); }
+	inline Vec4 operator*(Vec4 const& v2) const { return Vec4(e[0] * v2.e[0], e[1] * v2.e[1], e[2] * v2.e[2], e[3] * v2.e[3]); }
+	inline Vec4 operator/(Vec4 const& v2) const { return Vec4(e[0] / v2.e[0], e[1] / v2.e[1], e[2] / v2.e[2], e[3] / v2.e[3]); }
+	inline Vec4 operator*(float const t) const { return Vec4(e[0] * t, e[1] * t, e[2] * t, e[3] * t); }
+	inline Vec4 operator/(float const t) const { return Vec4(e[0] / t, e[1] / t, e[2] / t, e[3] / t); }
+
+	// Operations that modify the vector
+	inline Vec4& operator+=(Vec4 const& v2) { e[0] += v2.e[0]; e[1] += v2.e[1]; e[2] += v2.e[2]; e[3] += v2.e[3]; return *this; }
+	inline Vec4& operator-=(Vec4 const& v2) { e[0] -= v2.e[0]; e[1] -= v2.e[1]; e[2] -= v2.e[2]; e[3] -= v2.e[3]; return *this; }
+	inline Vec4& operator*=(float const t) { e[0] *= t; e[1] *= t; e[2] *= t; e[3] *= t; return *this; }
+	inline Vec4& operator/=(float const t) { e[0] /= t; e[1] /= t; e[2] /= t; e[3] /= t; return *this; }
+#else
+	// Operations that don't modify the vector
+	inline Vec4 operator+(Vec4 const& v2) const { return Vec4(_mm_add_ps(m, v2.m)); }
+	inline Vec4 operator-(Vec4 const& v2) const { return Vec4(_mm_sub_ps(m, v2.m)); }
+	inline Vec4 operator*(Vec4 const& v2) const { return Vec4(_mm_mul_ps(m, v2.m)); }
+	inline Vec4 operator/(Vec4 const& v2) const { return Vec4(_mm_div_ps(m, v2.m)); }
+	inline Vec4 operator*(float const t) const { return Vec4(_mm_mul_ps(m, _mm_set1_ps(t))); }
+	inline Vec4 operator/(float const t) const { return Vec4(_mm_div_ps(m, _mm_set1_ps(t))); }
+
+	// Operations that modify the vector
+	inline Vec4& operator+=(Vec4 const& v2) { m = _mm_add_ps(m, v2.m); return *this; }
+	inline Vec4& operator-=(Vec4 const& v2) { m = _mm_sub_ps(m, v2.m); return *this; }
+	inline Vec4& operator*=(float const t) { m = _mm_mul_ps(m, _mm_set1_ps(t)); return *this; }
+	inline Vec4& operator/=(float const t) { m = _mm_div_ps(m, _mm_set1_ps(t)); return *this; }
+#endif
+};
+
+inline Vec4 operator*(float const t, Vec4 const& v2) { return v2 * t; }
+
+#if VEC_ISA == VEC_ISA_SCALAR
+inline float dot(Vec4 const& v1, Vec4 const& v2) { return v1.x() * v2.x() + v1.y() * v2.y() + v1.z() * v2.z() + v1.w() * v2.w(); }
+#else
+inline float dot(Vec4 const& v1, Vec4 const& v2) {
+	__m128 const p = _mm_mul_ps(v1.simd(), v2.simd());
+	__m128 const pairs = _mm_add_ps(p, _mm_movehl_ps(p, p));
+	return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+#endif
\ No newline at end of file